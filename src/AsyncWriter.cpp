@@ -0,0 +1,367 @@
+//============================================================================
+// Name        : AsyncWriter.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Writes the files of the storage in the background.
+//============================================================================
+
+#include "AsyncWriter.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ScanVan {
+
+static std::shared_ptr<uint8_t> alignedAlloc(size_t n, size_t alignment) {
+	void *p = nullptr;
+	if (posix_memalign(&p, alignment, n) != 0) {
+		throw std::runtime_error("Could not allocate the aligned buffer of the writer.");
+	}
+	return std::shared_ptr<uint8_t>(static_cast<uint8_t *>(p), free);
+}
+
+AsyncWriter::AsyncWriter(size_t depth, bool direct) : depth { std::max<size_t>(1, depth) }, direct { direct } {
+#ifdef USE_IO_URING
+	// A file takes two entries at most: its aligned part and its padded tail
+	int err = io_uring_queue_init(static_cast<unsigned>(2 * this->depth), &ring, 0);
+	if (err == 0) {
+		useRing = true;
+		reaper = std::thread(&AsyncWriter::Reap, this);
+	} else {
+		std::cerr << "io_uring is not available (" << strerror(-err) << "), the files are written by a pool of threads." << std::endl;
+	}
+#endif
+	if (!useRing) {
+		// One thread per write in flight, each one blocks on its own write
+		for (size_t i = 0; i < this->depth; ++i) {
+			workers.emplace_back(&AsyncWriter::Work, this);
+		}
+	}
+}
+
+void AsyncWriter::CheckError() {
+// Throws the first error of the writes in the background, once
+	std::lock_guard<std::mutex> lg { m };
+	if (!error.empty()) {
+		std::string e { };
+		e.swap(error);
+		throw std::runtime_error(e);
+	}
+}
+
+void AsyncWriter::Prepare(Job &job, int dirfd) {
+// Opens and preallocates the file and cuts the data into the writes.
+// With O_DIRECT the address, the size and the offset of the writes are aligned: the data is written from its
+// buffer if it is aligned (the buffers of the frame pool are) and only the tail is copied into a padded block,
+// otherwise all the data is copied. The file is truncated to its size once written.
+
+	const std::string &name = job.file.name;
+	const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+	bool d = direct;
+	if (d) {
+		job.fd = openat(dirfd, name.c_str(), flags | O_DIRECT, 0644);
+		if ((job.fd < 0) && (errno == EINVAL)) {
+			if (direct.exchange(false)) {
+				std::cerr << "The file system does not support O_DIRECT, the files are written through the page cache." << std::endl;
+			}
+			d = false;
+		}
+	}
+	if (!d) {
+		job.fd = openat(dirfd, name.c_str(), flags, 0644);
+	}
+	if (job.fd < 0) {
+		throw std::runtime_error("Could not open the file " + name + " for writing");
+	}
+
+	const uint8_t *p = job.file.data();
+	const size_t n = job.file.size();
+	job.numChunks = 0;
+	if (!d) {
+		if (n > 0) {
+			job.chunks[job.numChunks++] = Chunk { &job, p, n, 0 };
+		}
+		job.written = n;
+	} else if (reinterpret_cast<uintptr_t>(p) % directAlignment == 0) {
+		const size_t head = n / directAlignment * directAlignment;
+		const size_t tail = n - head;
+		if (head > 0) {
+			job.chunks[job.numChunks++] = Chunk { &job, p, head, 0 };
+		}
+		if (tail > 0) {
+			job.bounce = alignedAlloc(directAlignment, directAlignment);
+			std::memcpy(job.bounce.get(), p + head, tail);
+			std::memset(job.bounce.get() + tail, 0, directAlignment - tail);
+			job.chunks[job.numChunks++] = Chunk { &job, job.bounce.get(), directAlignment, head };
+		}
+		job.written = head + ((tail > 0) ? directAlignment : 0);
+	} else {
+		const size_t padded = (n + directAlignment - 1) / directAlignment * directAlignment;
+		if (padded > 0) {
+			job.bounce = alignedAlloc(padded, directAlignment);
+			std::memcpy(job.bounce.get(), p, n);
+			std::memset(job.bounce.get() + n, 0, padded - n);
+			job.chunks[job.numChunks++] = Chunk { &job, job.bounce.get(), padded, 0 };
+		}
+		job.written = padded;
+	}
+
+	if (job.written > 0) {
+		// Reserves the extents at once, a failure (e.g. not supported) only costs the fragmentation
+		fallocate(job.fd, 0, 0, static_cast<off_t>(job.written));
+	}
+	job.pending = job.numChunks;
+}
+
+void AsyncWriter::write(int dirfd, StorageFile file) {
+
+	CheckError();
+
+	Job *job = new Job { };
+	job->file = std::move(file);
+	{
+		std::unique_lock<std::mutex> lg { m };
+		cv.wait(lg, [this] { return inFlight < depth; });
+		++inFlight;
+		job->seq = nextSeq++;
+		outstanding.insert(job->seq);
+	}
+
+	try {
+		Prepare(*job, dirfd);
+	} catch (const std::exception &e) {
+		job->error = e.what();
+	}
+
+	if ((!job->error.empty()) || (job->numChunks == 0)) {
+		Complete(job);
+#ifdef USE_IO_URING
+	} else if (useRing) {
+		std::lock_guard<std::mutex> lg { ringMutex };
+		for (int i = 0; i < job->numChunks; ++i) {
+			SubmitChunk(&job->chunks[i]);
+		}
+		io_uring_submit(&ring);
+#endif
+	} else {
+		std::lock_guard<std::mutex> lg { m };
+		jobs.push_back(job);
+		cv.notify_all();
+	}
+}
+
+void AsyncWriter::commit(int dirfd, StorageFile file) {
+
+	CheckError();
+
+	// The directory may be closed by the caller before the commit is written
+	int fd = fcntl(dirfd, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		throw std::runtime_error("Could not duplicate the directory of the file " + file.name);
+	}
+	{
+		std::lock_guard<std::mutex> lg { m };
+		commits.push_back(Commit { nextSeq, fd, std::move(file) });
+	}
+	RunCommits();
+}
+
+void AsyncWriter::RunCommits() {
+// Writes the commits whose preceding writes are all complete, in their order.
+// They are small files written through the page cache by the thread that made them ready.
+
+	std::lock_guard<std::mutex> cl { commitMutex };
+	while (true) {
+		Commit *c = nullptr;
+		{
+			std::lock_guard<std::mutex> lg { m };
+			if (commits.empty()) break;
+			c = &commits.front();
+			if ((!outstanding.empty()) && (*outstanding.begin() < c->seq)) break;
+		}
+
+		std::string err { };
+		try {
+			c->file.writeAt(c->dirfd);
+		} catch (const std::exception &e) {
+			err = e.what();
+		}
+		close(c->dirfd);
+
+		{
+			std::lock_guard<std::mutex> lg { m };
+			if ((!err.empty()) && error.empty()) {
+				error = err;
+			}
+			commits.pop_front();
+		}
+		cv.notify_all();
+	}
+}
+
+void AsyncWriter::Complete(Job *job) {
+// Gives the padding back and closes the file, then writes the commits that were waiting for it
+
+	if (job->fd >= 0) {
+		if (job->error.empty() && (job->written != job->file.size())
+				&& (ftruncate(job->fd, static_cast<off_t>(job->file.size())) != 0)) {
+			job->error = "Could not truncate the file " + job->file.name + ": " + strerror(errno);
+		}
+		close(job->fd);
+	}
+	{
+		std::lock_guard<std::mutex> lg { m };
+		if ((!job->error.empty()) && error.empty()) {
+			error = job->error;
+		}
+		outstanding.erase(job->seq);
+		--inFlight;
+	}
+	cv.notify_all();
+
+	// The data of the file (e.g. the buffer of the frame pool) is released here
+	delete job;
+
+	RunCommits();
+}
+
+void AsyncWriter::Work() {
+// Thread of the pool: writes the files one by one
+
+	while (true) {
+		Job *job = nullptr;
+		{
+			std::unique_lock<std::mutex> lg { m };
+			cv.wait(lg, [this] { return stopping || !jobs.empty(); });
+			if (jobs.empty()) {
+				// Stopping and nothing left to do
+				return;
+			}
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		for (int i = 0; (i < job->numChunks) && job->error.empty(); ++i) {
+			Chunk &c = job->chunks[i];
+			while (c.n > 0) {
+				ssize_t w = pwrite(job->fd, c.p, c.n, static_cast<off_t>(c.offset));
+				if (w < 0) {
+					if (errno == EINTR) continue;
+					job->error = "Error writing the file " + job->file.name + ": " + strerror(errno);
+					break;
+				}
+				c.p += w;
+				c.n -= static_cast<size_t>(w);
+				c.offset += static_cast<uint64_t>(w);
+			}
+		}
+		Complete(job);
+	}
+}
+
+#ifdef USE_IO_URING
+void AsyncWriter::SubmitChunk(Chunk *c) {
+// Queues the write of the chunk, ringMutex is held by the caller.
+// The ring has room for all the chunks in flight, the queue is only full if it was not submitted yet.
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+	if (sqe == nullptr) {
+		io_uring_submit(&ring);
+		sqe = io_uring_get_sqe(&ring);
+	}
+	if (sqe == nullptr) {
+		throw std::runtime_error("The submission queue of io_uring is full.");
+	}
+	io_uring_prep_write(sqe, c->job->fd, c->p, static_cast<unsigned>(c->n), c->offset);
+	io_uring_sqe_set_data(sqe, c);
+}
+
+void AsyncWriter::Reap() {
+// Thread that takes the completions of the ring. A short write is submitted again for the rest of the chunk.
+// A completion without chunk stops the thread.
+
+	while (true) {
+		struct io_uring_cqe *cqe = nullptr;
+		int err = io_uring_wait_cqe(&ring, &cqe);
+		if (err == -EINTR) continue;
+		if (err < 0) {
+			std::lock_guard<std::mutex> lg { m };
+			error = std::string { "Error waiting for the writes: " } + strerror(-err);
+			return;
+		}
+		Chunk *c = static_cast<Chunk *>(io_uring_cqe_get_data(cqe));
+		int res = cqe->res;
+		io_uring_cqe_seen(&ring, cqe);
+		if (c == nullptr) {
+			return;
+		}
+
+		Job *job = c->job;
+		if ((res == -EINTR) || (res == -EAGAIN) || ((res > 0) && (static_cast<size_t>(res) < c->n))) {
+			if (res > 0) {
+				c->p += res;
+				c->n -= static_cast<size_t>(res);
+				c->offset += static_cast<uint64_t>(res);
+			}
+			std::lock_guard<std::mutex> lg { ringMutex };
+			SubmitChunk(c);
+			io_uring_submit(&ring);
+			continue;
+		}
+		if (res < 0) {
+			job->error = "Error writing the file " + job->file.name + ": " + strerror(-res);
+		} else if (res == 0) {
+			job->error = "Error writing the file " + job->file.name + ": no progress";
+		}
+		if (--job->pending == 0) {
+			Complete(job);
+		}
+	}
+}
+#endif
+
+void AsyncWriter::drain() {
+	{
+		std::unique_lock<std::mutex> lg { m };
+		cv.wait(lg, [this] { return (inFlight == 0) && commits.empty(); });
+	}
+	CheckError();
+}
+
+AsyncWriter::~AsyncWriter() {
+	try {
+		drain();
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+	}
+
+#ifdef USE_IO_URING
+	if (useRing) {
+		{
+			std::lock_guard<std::mutex> lg { ringMutex };
+			struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+			io_uring_prep_nop(sqe);
+			io_uring_sqe_set_data(sqe, nullptr);
+			io_uring_submit(&ring);
+		}
+		reaper.join();
+		io_uring_queue_exit(&ring);
+	}
+#endif
+	{
+		std::lock_guard<std::mutex> lg { m };
+		stopping = true;
+	}
+	cv.notify_all();
+	for (auto &t : workers) {
+		t.join();
+	}
+}
+
+} /* namespace ScanVan */
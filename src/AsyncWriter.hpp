@@ -0,0 +1,133 @@
+//============================================================================
+// Name        : AsyncWriter.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Writes the files of the storage in the background, with a
+//				 bounded number of writes in flight. The files are opened
+//				 with O_DIRECT and preallocated, and the images are written
+//				 in page-aligned blocks, so the recording bypasses the page
+//				 cache: no writeback stalls, and the calibration maps stay in
+//				 memory. The writes are submitted through io_uring when the
+//				 program is built with liburing (USE_IO_URING) and the kernel
+//				 supports it, otherwise they are done by a pool of threads.
+//
+//				 The files given to commit are written once all the writes
+//				 submitted before them are complete, in the order of commit.
+//============================================================================
+
+#ifndef ASYNCWRITER_HPP_
+#define ASYNCWRITER_HPP_
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <stdint.h>
+
+#ifdef USE_IO_URING
+#include <liburing.h>
+#endif
+
+#include "StorageFile.hpp"
+
+namespace ScanVan {
+
+class AsyncWriter {
+private:
+	// Alignment of the address, the size and the offset of the writes with O_DIRECT
+	static const size_t directAlignment = 4096;
+
+	struct Job;
+
+	struct Chunk {
+		Job *job = nullptr;
+		const uint8_t *p = nullptr;
+		size_t n = 0;
+		uint64_t offset = 0;
+	};
+
+	struct Job {
+		StorageFile file { };
+		uint64_t seq = 0;
+		int fd = -1;
+		std::shared_ptr<uint8_t> bounce { };	// aligned copy of the data that cannot be written from its buffer
+		size_t written = 0;						// size of the file after the writes, padded to the alignment
+		Chunk chunks[2] { };
+		int numChunks = 0;
+		int pending = 0;						// chunks not yet written
+		std::string error { };
+	};
+
+	struct Commit {
+		uint64_t seq;		// written once all the writes before seq are complete
+		int dirfd;
+		StorageFile file;
+	};
+
+	size_t depth;
+	std::atomic<bool> direct;				// cleared if the file system does not support O_DIRECT
+
+	std::mutex m { };
+	std::condition_variable cv { };
+	size_t inFlight { 0 };
+	uint64_t nextSeq { 0 };
+	std::set<uint64_t> outstanding { };		// writes not yet complete
+	std::deque<Commit> commits { };
+	std::string error { };					// first error, thrown by the next call
+	bool stopping { false };
+
+	std::mutex commitMutex { };				// one thread at a time writes the commits, in their order
+
+	// Pool of threads, when io_uring is not used
+	std::deque<Job *> jobs { };
+	std::vector<std::thread> workers { };
+
+#ifdef USE_IO_URING
+	struct io_uring ring { };
+	std::mutex ringMutex { };
+	std::thread reaper { };
+	void SubmitChunk(Chunk *c);
+	void Reap();
+#endif
+	bool useRing { false };
+
+	void Prepare(Job &job, int dirfd);
+	void Complete(Job *job);
+	void RunCommits();
+	void Work();
+	void CheckError();
+
+public:
+	// depth is the maximum number of files being written, write waits while they are all in flight.
+	// Without direct the files go through the page cache, the writes are still asynchronous.
+	AsyncWriter(size_t depth, bool direct = true);
+
+	AsyncWriter(const AsyncWriter &) = delete;
+	AsyncWriter & operator=(const AsyncWriter &) = delete;
+
+	// Writes the file relative to the directory dirfd in the background. The file keeps its data alive until
+	// it is written. The directory is only used during the call.
+	void write(int dirfd, StorageFile file);
+
+	// Writes the file relative to the directory dirfd once all the files given to write before are complete
+	void commit(int dirfd, StorageFile file);
+
+	// Waits until all the files are written. The errors of the writes in the background are thrown by write,
+	// commit and drain.
+	void drain();
+
+	std::string getBackend() const { return (useRing) ? "io_uring" : "threads"; }
+	size_t getDepth() const { return depth; }
+
+	virtual ~AsyncWriter();
+};
+
+} /* namespace ScanVan */
+
+#endif /* ASYNCWRITER_HPP_ */
@@ -0,0 +1,300 @@
+//============================================================================
+// Name        : BayerCodec.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Lossless compression of the BayerRG8 images.
+//============================================================================
+
+#include "BayerCodec.hpp"
+
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+
+namespace ScanVan {
+
+namespace {
+
+const char codecMagic[4] = { 'S', 'V', 'B', 'C' };
+
+// Quotients from escapeBits on are written as escapeBits ones followed by the 8 bits of the value
+const int escapeBits = 16;
+const int maxK = 7;
+
+// Running mean of the coded values of one plane, it gives the parameter of the Rice code
+struct RiceContext {
+	uint32_t a = 16;	// sum of the values
+	uint32_t n = 1;		// number of values
+
+	int k() const {
+		int k = 0;
+		while (((n << k) < a) && (k < maxK)) ++k;
+		return k;
+	}
+
+	void update(uint32_t u) {
+		a += u;
+		if (++n == 64) {
+			a >>= 1;
+			n >>= 1;
+		}
+	}
+};
+
+class BitWriter {
+	std::vector<uint8_t> &out;
+	uint64_t acc = 0;
+	int bits = 0;
+public:
+	BitWriter(std::vector<uint8_t> &out) : out { out } {};
+
+	void put(uint32_t v, int n) {
+		acc = (acc << n) | v;
+		bits += n;
+		while (bits >= 8) {
+			bits -= 8;
+			out.push_back(static_cast<uint8_t>(acc >> bits));
+		}
+	}
+
+	void flush() {
+		if (bits > 0) {
+			out.push_back(static_cast<uint8_t>(acc << (8 - bits)));
+			bits = 0;
+		}
+	}
+};
+
+class BitReader {
+	const uint8_t *p;
+	const uint8_t *end;
+	uint64_t acc = 0;
+	int bits = 0;
+	size_t over = 0;	// bytes read after the end
+public:
+	BitReader(const uint8_t *p, size_t n) : p { p }, end { p + n } {};
+
+	uint32_t get(int n) {
+		if (bits < n) {
+			while (bits <= 56) {
+				if (p < end) {
+					acc = (acc << 8) | *p++;
+				} else {
+					acc <<= 8;
+					++over;
+				}
+				bits += 8;
+			}
+		}
+		bits -= n;
+		return static_cast<uint32_t>(acc >> bits) & ((1u << n) - 1);
+	}
+
+	// The stream is padded with at most one byte, more means that it was truncated
+	bool overrun() const { return over * 8 > static_cast<size_t>(bits) + 8; }
+};
+
+inline int predict(const uint8_t *cur, const uint8_t *up, size_t i, size_t j) {
+// Median edge detector on the neighbours of the same plane: left (a), up (b) and up-left (c).
+// The first row of a strip only uses the left neighbour, so the strips are independent.
+	if (i == 0) {
+		return (j == 0) ? 0 : cur[2 * j - 2];
+	}
+	if (j == 0) {
+		return up[0];
+	}
+	int a = cur[2 * j - 2];
+	int b = up[2 * j];
+	int c = up[2 * j - 2];
+	int mx = std::max(a, b);
+	int mn = std::min(a, b);
+	if (c >= mx) return mn;
+	if (c <= mn) return mx;
+	return a + b - c;
+}
+
+} /* namespace */
+
+BayerCodec::BayerCodec(size_t numThreads, uint32_t stripRows) :
+		pool { (numThreads == 0) ? std::max<size_t>(1, std::thread::hardware_concurrency()) : numThreads },
+		stripRows { std::max<uint32_t>(2, (stripRows + 1) & ~1u) } {
+}
+
+size_t BayerCodec::EncodeStrip(const uint8_t *bayer, size_t width, size_t rows, std::vector<uint8_t> &out) {
+// The rows of the four planes are interleaved: for each pair of rows of the mosaic, the R, G, G and B rows
+
+	RiceContext ctx[4] { };
+	BitWriter bw { out };
+	const size_t pw = width / 2;
+
+	for (size_t i = 0; i < rows / 2; ++i) {
+		for (int p = 0; p < 4; ++p) {
+			const uint8_t *cur = bayer + (2 * i + (p >> 1)) * width + (p & 1);
+			const uint8_t *up = cur - 2 * width;
+			RiceContext &c = ctx[p];
+			for (size_t j = 0; j < pw; ++j) {
+				// The residual modulo 256 in [-128, 127], zigzag: 0, -1, 1, -2, ... gives 0, 1, 2, 3, ...
+				int e = static_cast<int8_t>(cur[2 * j] - predict(cur, up, i, j));
+				uint32_t u = (e >= 0) ? 2 * e : -2 * e - 1;
+				int k = c.k();
+				uint32_t q = u >> k;
+				if (q < static_cast<uint32_t>(escapeBits)) {
+					bw.put(((1u << q) - 1) << 1, q + 1);
+					if (k > 0) bw.put(u & ((1u << k) - 1), k);
+				} else {
+					bw.put((1u << escapeBits) - 1, escapeBits);
+					bw.put(u, 8);
+				}
+				c.update(u);
+			}
+		}
+	}
+	bw.flush();
+	return out.size();
+}
+
+void BayerCodec::DecodeStrip(const uint8_t *in, size_t n, uint8_t *bayer, size_t width, size_t rows) {
+
+	RiceContext ctx[4] { };
+	BitReader br { in, n };
+	const size_t pw = width / 2;
+
+	for (size_t i = 0; i < rows / 2; ++i) {
+		for (int p = 0; p < 4; ++p) {
+			uint8_t *cur = bayer + (2 * i + (p >> 1)) * width + (p & 1);
+			const uint8_t *up = cur - 2 * width;
+			RiceContext &c = ctx[p];
+			for (size_t j = 0; j < pw; ++j) {
+				int k = c.k();
+				uint32_t q = 0;
+				while ((q < static_cast<uint32_t>(escapeBits)) && (br.get(1) == 1)) ++q;
+				uint32_t u { };
+				if (q < static_cast<uint32_t>(escapeBits)) {
+					u = (q << k) | ((k > 0) ? br.get(k) : 0);
+				} else {
+					u = br.get(8);
+				}
+				if (u > 255) {
+					throw std::runtime_error("The coded Bayer image is corrupted.");
+				}
+				int e = static_cast<int>(u >> 1) ^ -static_cast<int>(u & 1);
+				cur[2 * j] = static_cast<uint8_t>(predict(cur, up, i, j) + e);
+				c.update(u);
+			}
+		}
+	}
+	if (br.overrun()) {
+		throw std::runtime_error("The coded Bayer image is truncated.");
+	}
+}
+
+void BayerCodec::encode(const uint8_t *bayer, size_t height, size_t width, std::vector<uint8_t> &out) {
+
+	if ((height % 2 != 0) || (width % 2 != 0)) {
+		throw std::runtime_error("The Bayer codec needs an even height and width.");
+	}
+	const size_t numStrips = (height + stripRows - 1) / stripRows;
+	std::vector<std::vector<uint8_t>> coded(numStrips);
+	std::vector<StripEntry> table(numStrips);
+
+	pool.parallel_for(numStrips, [&](size_t s) {
+		const size_t rows = std::min<size_t>(stripRows, height - s * stripRows);
+		const uint8_t *src = bayer + s * stripRows * width;
+		coded[s].reserve(rows * width / 2);
+		EncodeStrip(src, width, rows, coded[s]);
+		if (coded[s].size() >= rows * width) {
+			// Noise does not compress, the strip is stored as is
+			coded[s].assign(src, src + rows * width);
+			table[s].method = 0;
+		} else {
+			table[s].method = 1;
+		}
+		table[s].bytes = static_cast<uint32_t>(coded[s].size());
+	});
+
+	Header h { };
+	std::memcpy(h.magic, codecMagic, sizeof(h.magic));
+	h.version = version;
+	h.height = static_cast<uint32_t>(height);
+	h.width = static_cast<uint32_t>(width);
+	h.stripRows = stripRows;
+	h.numStrips = static_cast<uint32_t>(numStrips);
+
+	size_t total = sizeof(h) + numStrips * sizeof(StripEntry);
+	for (const auto &c : coded) {
+		total += c.size();
+	}
+	out.resize(total);
+	uint8_t *p = out.data();
+	std::memcpy(p, &h, sizeof(h));
+	p += sizeof(h);
+	std::memcpy(p, table.data(), numStrips * sizeof(StripEntry));
+	p += numStrips * sizeof(StripEntry);
+	for (const auto &c : coded) {
+		std::memcpy(p, c.data(), c.size());
+		p += c.size();
+	}
+}
+
+bool BayerCodec::readSize(const uint8_t *in, size_t n, size_t &height, size_t &width) {
+	Header h { };
+	if (n < sizeof(h)) return false;
+	std::memcpy(&h, in, sizeof(h));
+	if ((std::memcmp(h.magic, codecMagic, sizeof(h.magic)) != 0) || (h.version != version)) return false;
+	height = h.height;
+	width = h.width;
+	return true;
+}
+
+void BayerCodec::decode(const uint8_t *in, size_t n, uint8_t *bayer, size_t height, size_t width) {
+
+	Header h { };
+	size_t hh { };
+	size_t ww { };
+	if (!readSize(in, n, hh, ww)) {
+		throw std::runtime_error("The data is not a coded Bayer image.");
+	}
+	std::memcpy(&h, in, sizeof(h));
+	if ((hh != height) || (ww != width)) {
+		throw std::runtime_error("The size of the coded Bayer image does not match the expected one.");
+	}
+	const size_t numStrips = h.numStrips;
+	if ((h.stripRows < 2) || (h.stripRows % 2 != 0) || (numStrips != (height + h.stripRows - 1) / h.stripRows)
+			|| (n < sizeof(h) + numStrips * sizeof(StripEntry))) {
+		throw std::runtime_error("The coded Bayer image has an invalid header.");
+	}
+
+	std::vector<StripEntry> table(numStrips);
+	std::memcpy(table.data(), in + sizeof(h), numStrips * sizeof(StripEntry));
+	std::vector<size_t> offsets(numStrips);
+	size_t offset = sizeof(h) + numStrips * sizeof(StripEntry);
+	for (size_t s = 0; s < numStrips; ++s) {
+		offsets[s] = offset;
+		offset += table[s].bytes;
+	}
+	if (offset > n) {
+		throw std::runtime_error("The coded Bayer image is truncated.");
+	}
+
+	pool.parallel_for(numStrips, [&](size_t s) {
+		const size_t rows = std::min<size_t>(h.stripRows, height - s * h.stripRows);
+		uint8_t *dst = bayer + s * h.stripRows * width;
+		if (table[s].method == 0) {
+			if (table[s].bytes != rows * width) {
+				throw std::runtime_error("The coded Bayer image has an invalid strip.");
+			}
+			std::memcpy(dst, in + offsets[s], rows * width);
+		} else {
+			DecodeStrip(in + offsets[s], table[s].bytes, dst, width, rows);
+		}
+	});
+}
+
+BayerCodec & BayerCodec::shared() {
+	static BayerCodec codec { 0 };
+	return codec;
+}
+
+} /* namespace ScanVan */
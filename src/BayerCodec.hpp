@@ -0,0 +1,75 @@
+//============================================================================
+// Name        : BayerCodec.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Lossless compression of the BayerRG8 images. The mosaic is
+//				 split into its four colour planes (R, G on the red rows, G on
+//				 the blue rows, B), each pixel is predicted from its
+//				 neighbours in the same plane (median edge detector of
+//				 LOCO-I) and the residuals are written with adaptive Rice
+//				 codes. The image is cut into strips of rows that are coded
+//				 independently, in parallel on a pool of threads.
+//
+//				 Stream: Header, one StripEntry per strip, then the strips.
+//============================================================================
+
+#ifndef BAYERCODEC_HPP_
+#define BAYERCODEC_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+#include "ThreadPool.hpp"
+
+namespace ScanVan {
+
+class BayerCodec {
+private:
+	struct Header {
+		char magic[4];			// "SVBC"
+		uint32_t version;
+		uint32_t height;
+		uint32_t width;
+		uint32_t stripRows;		// rows of the mosaic per strip, even
+		uint32_t numStrips;
+	};
+
+	struct StripEntry {
+		uint32_t bytes;			// size of the coded strip
+		uint32_t method;		// 0: stored as is, 1: Rice coded
+	};
+
+	static const uint32_t version = 1;
+
+	ThreadPool pool;
+	uint32_t stripRows;
+
+	static size_t EncodeStrip(const uint8_t *bayer, size_t width, size_t rows, std::vector<uint8_t> &out);
+	static void DecodeStrip(const uint8_t *in, size_t n, uint8_t *bayer, size_t width, size_t rows);
+
+public:
+	// numThreads = 0 uses one thread per core
+	BayerCodec(size_t numThreads, uint32_t stripRows = 64);
+
+	BayerCodec(const BayerCodec &) = delete;
+	BayerCodec & operator=(const BayerCodec &) = delete;
+
+	// Codes the height x width mosaic into out. The height and the width must be even.
+	void encode(const uint8_t *bayer, size_t height, size_t width, std::vector<uint8_t> &out);
+
+	// Decodes the stream in[0, n) into bayer, which holds height x width pixels
+	void decode(const uint8_t *in, size_t n, uint8_t *bayer, size_t height, size_t width);
+
+	// Reads the size of the image from the stream, returns false if it is not a coded image
+	static bool readSize(const uint8_t *in, size_t n, size_t &height, size_t &width);
+
+	// Codec shared by the loaders of the images, created at the first use
+	static BayerCodec & shared();
+
+	size_t getNumThreads() const { return pool.size(); }
+};
+
+} /* namespace ScanVan */
+
+#endif /* BAYERCODEC_HPP_ */
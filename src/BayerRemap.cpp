@@ -0,0 +1,201 @@
+//============================================================================
+// Name        : BayerRemap.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Remaps a BayerRG8 image into the equirectangular RGB image in
+//				 one pass.
+//============================================================================
+
+#include "BayerRemap.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+namespace ScanVan {
+
+static inline void demosaic(const uint8_t *p, int r, int c, ptrdiff_t up, ptrdiff_t down, ptrdiff_t left, ptrdiff_t right, int bgr[3]) {
+// Bilinear demosaicing of the RGGB mosaic at the pixel p, in row r and column c.
+// up, down, left and right are the offsets of the neighbours. The values are scaled by 4.
+	int centre = 4 * p[0];
+	int horiz = p[left] + p[right];
+	int vert = p[up] + p[down];
+	switch (((r & 1) << 1) | (c & 1)) {
+	case 0:	// red
+		bgr[0] = p[up + left] + p[up + right] + p[down + left] + p[down + right];
+		bgr[1] = horiz + vert;
+		bgr[2] = centre;
+		break;
+	case 1:	// green on a red row
+		bgr[0] = 2 * vert;
+		bgr[1] = centre;
+		bgr[2] = 2 * horiz;
+		break;
+	case 2:	// green on a blue row
+		bgr[0] = 2 * horiz;
+		bgr[1] = centre;
+		bgr[2] = 2 * vert;
+		break;
+	default: // blue
+		bgr[0] = centre;
+		bgr[1] = horiz + vert;
+		bgr[2] = p[up + left] + p[up + right] + p[down + left] + p[down + right];
+		break;
+	}
+}
+
+static inline void demosaicBorder(const uint8_t *bayer, int height, int width, int r, int c, int bgr[3]) {
+// Same as demosaic for a pixel on the border. The neighbours outside of the mosaic are mirrored,
+// which keeps the colour of the neighbour. Pixels outside of the mosaic are black.
+	if ((r < 0) || (c < 0) || (r >= height) || (c >= width)) {
+		bgr[0] = bgr[1] = bgr[2] = 0;
+		return;
+	}
+	ptrdiff_t w = width;
+	ptrdiff_t up = (r > 0) ? -w : w;
+	ptrdiff_t down = (r < height - 1) ? w : -w;
+	ptrdiff_t left = (c > 0) ? -1 : 1;
+	ptrdiff_t right = (c < width - 1) ? 1 : -1;
+	demosaic(bayer + r * w + c, r, c, up, down, left, right, bgr);
+}
+
+void bayerRemapRows(const uint8_t *bayer, int height, int width,
+		const int16_t *xy, size_t xyStride, const uint16_t *frac, size_t fracStride,
+		uint8_t *dst, size_t dstStride, int dstWidth, int rowStart, int rowEnd, bool nearest) {
+
+	const ptrdiff_t w = width;
+	const int tabMask = cv::INTER_TAB_SIZE - 1;
+	const int half = cv::INTER_TAB_SIZE / 2;
+
+	for (int i = rowStart; i < rowEnd; ++i) {
+		const int16_t *pxy = xy + i * xyStride;
+		const uint16_t *pfrac = (frac != nullptr) ? frac + i * fracStride : nullptr;
+		uint8_t *pdst = dst + i * dstStride;
+
+		for (int j = 0; j < dstWidth; ++j) {
+			int x = pxy[2 * j];
+			int y = pxy[2 * j + 1];
+			int f = (pfrac != nullptr) ? (pfrac[j] & (cv::INTER_TAB_SIZE * cv::INTER_TAB_SIZE - 1)) : 0;
+			int fx = f & tabMask;
+			int fy = f >> cv::INTER_BITS;
+			if (nearest) {
+				// Only the pixel at the rounded position is taken
+				x += (fx >= half) ? 1 : 0;
+				y += (fy >= half) ? 1 : 0;
+				fx = 0;
+				fy = 0;
+			}
+
+			// Weights of the four neighbours, they sum to INTER_TAB_SIZE^2
+			int weight[4] = { (cv::INTER_TAB_SIZE - fx) * (cv::INTER_TAB_SIZE - fy), fx * (cv::INTER_TAB_SIZE - fy),
+					(cv::INTER_TAB_SIZE - fx) * fy, fx * fy };
+
+			int bgr[4][3] { };
+			if ((x >= 1) && (y >= 1) && (x + 2 < width) && (y + 2 < height)) {
+				// All the neighbours are inside of the mosaic
+				const uint8_t *p = bayer + y * w + x;
+				demosaic(p, y, x, -w, w, -1, 1, bgr[0]);
+				if (weight[1] != 0) demosaic(p + 1, y, x + 1, -w, w, -1, 1, bgr[1]);
+				if (weight[2] != 0) demosaic(p + w, y + 1, x, -w, w, -1, 1, bgr[2]);
+				if (weight[3] != 0) demosaic(p + w + 1, y + 1, x + 1, -w, w, -1, 1, bgr[3]);
+			} else {
+				demosaicBorder(bayer, height, width, y, x, bgr[0]);
+				if (weight[1] != 0) demosaicBorder(bayer, height, width, y, x + 1, bgr[1]);
+				if (weight[2] != 0) demosaicBorder(bayer, height, width, y + 1, x, bgr[2]);
+				if (weight[3] != 0) demosaicBorder(bayer, height, width, y + 1, x + 1, bgr[3]);
+			}
+
+			// The values are scaled by 4 (demosaic) and by INTER_TAB_SIZE^2 (weights)
+			const int shift = 2 + 2 * cv::INTER_BITS;
+			for (int k = 0; k < 3; ++k) {
+				int v = weight[0] * bgr[0][k] + weight[1] * bgr[1][k] + weight[2] * bgr[2][k] + weight[3] * bgr[3][k];
+				pdst[3 * j + k] = static_cast<uint8_t>((v + (1 << (shift - 1))) >> shift);
+			}
+		}
+	}
+}
+
+void bayerDemosaicRows(const uint8_t *bayer, int height, int width, uint8_t *dst, size_t dstStride, int rowStart, int rowEnd) {
+
+	const ptrdiff_t w = width;
+
+	for (int i = rowStart; i < rowEnd; ++i) {
+		uint8_t *pdst = dst + i * dstStride;
+		const bool innerRow = (i >= 1) && (i + 1 < height);
+		for (int j = 0; j < width; ++j) {
+			int bgr[3] { };
+			if (innerRow && (j >= 1) && (j + 1 < width)) {
+				demosaic(bayer + i * w + j, i, j, -w, w, -1, 1, bgr);
+			} else {
+				demosaicBorder(bayer, height, width, i, j, bgr);
+			}
+			// The values are scaled by 4
+			for (int k = 0; k < 3; ++k) {
+				pdst[3 * j + k] = static_cast<uint8_t>((bgr[k] + 2) >> 2);
+			}
+		}
+	}
+}
+
+void bayerRemap(const uint8_t *bayer, int height, int width, const cv::Mat &map_1, const cv::Mat &map_2, cv::Mat &dst) {
+
+	if (map_1.type() != CV_16SC2) {
+		throw std::runtime_error("bayerRemap needs the maps converted with cv::convertMaps to CV_16SC2.");
+	}
+	const bool hasFrac = !map_2.empty();
+	if (hasFrac && ((map_2.type() != CV_16UC1) || (map_2.size() != map_1.size()))) {
+		throw std::runtime_error("bayerRemap needs the second map of type CV_16UC1 and of the size of the first one.");
+	}
+
+	dst.create(map_1.rows, map_1.cols, CV_8UC3);
+
+	const int16_t *xy = map_1.ptr<int16_t>(0);
+	const size_t xyStride = map_1.step / sizeof(int16_t);
+	const uint16_t *frac = hasFrac ? map_2.ptr<uint16_t>(0) : nullptr;
+	const size_t fracStride = hasFrac ? map_2.step / sizeof(uint16_t) : 0;
+	uint8_t *out = dst.ptr<uint8_t>(0);
+	const size_t dstStride = dst.step;
+	const int dstWidth = map_1.cols;
+
+	cv::parallel_for_(cv::Range(0, map_1.rows), [&](const cv::Range &range) {
+		bayerRemapRows(bayer, height, width, xy, xyStride, frac, fracStride, out, dstStride, dstWidth, range.start, range.end);
+	});
+}
+
+void bayerSuperpixel(const uint8_t *bayer, int height, int width, cv::Mat &dst) {
+	const int rows = height / 2;
+	const int cols = width / 2;
+	dst.create(rows, cols, CV_8UC3);
+
+	cv::parallel_for_(cv::Range(0, rows), [&](const cv::Range &range) {
+		for (int i = range.start; i < range.end; ++i) {
+			const uint8_t *p0 = bayer + (2 * i) * static_cast<ptrdiff_t>(width);	// R G R G ...
+			const uint8_t *p1 = p0 + width;											// G B G B ...
+			uint8_t *out = dst.ptr<uint8_t>(i);
+			for (int j = 0; j < cols; ++j) {
+				out[3 * j] = p1[2 * j + 1];
+				out[3 * j + 1] = static_cast<uint8_t>((p0[2 * j + 1] + p1[2 * j] + 1) >> 1);
+				out[3 * j + 2] = p0[2 * j];
+			}
+		}
+	});
+}
+
+void superpixelMaps(const cv::Mat &mapX, const cv::Mat &mapY, int width, cv::Mat &previewX, cv::Mat &previewY) {
+
+	if ((width <= 0) || (width > mapX.cols)) {
+		throw std::runtime_error("The width of the preview must be positive and at most the width of the map.");
+	}
+	const int rows = std::max(1, static_cast<int>(std::lround(static_cast<double>(mapX.rows) * width / mapX.cols)));
+	const cv::Size size { width, rows };
+
+	// The superpixel j is centred on the column 2 * j + 0.5 of the mosaic
+	cv::Mat tmp { };
+	cv::resize(mapX, tmp, size, 0, 0, cv::INTER_AREA);
+	tmp.convertTo(previewX, CV_32FC1, 0.5, -0.25);
+	cv::resize(mapY, tmp, size, 0, 0, cv::INTER_AREA);
+	tmp.convertTo(previewY, CV_32FC1, 0.5, -0.25);
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,55 @@
+//============================================================================
+// Name        : BayerRemap.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Remaps a BayerRG8 image into the equirectangular RGB image in
+//				 one pass. The mosaic is demosaiced only at the four pixels
+//				 around each position of the map, so the full resolution RGB
+//				 image (3008 x 3008 x 3) is never built.
+//============================================================================
+
+#ifndef BAYERREMAP_HPP_
+#define BAYERREMAP_HPP_
+
+#include <stdint.h>
+
+// Include files to use OpenCV API
+#include <opencv2/opencv.hpp>
+
+namespace ScanVan {
+
+// Remaps the rows [rowStart, rowEnd) of the destination.
+// xy holds the integer source positions (x, y) of each destination pixel, as in the CV_16SC2 map,
+// and frac the fractional part as an index in the INTER_TAB_SIZE x INTER_TAB_SIZE table, as in the
+// CV_16UC1 map, or nullptr for the integer positions. The strides are in elements.
+// The four pixels around the position are interpolated linearly, or with nearest the position is rounded
+// to the closest pixel, as cv::INTER_NEAREST does.
+// The pixels are written in BGR order, positions outside of the mosaic are black.
+void bayerRemapRows(const uint8_t *bayer, int height, int width,
+		const int16_t *xy, size_t xyStride, const uint16_t *frac, size_t fracStride,
+		uint8_t *dst, size_t dstStride, int dstWidth, int rowStart, int rowEnd, bool nearest = false);
+
+// Demosaics the rows [rowStart, rowEnd) of the BayerRG8 image into the BGR image dst (width x height),
+// with the same bilinear demosaicing as bayerRemapRows. It gives the source of the interpolations that
+// need more than the four pixels around the position (bicubic).
+void bayerDemosaicRows(const uint8_t *bayer, int height, int width, uint8_t *dst, size_t dstStride, int rowStart, int rowEnd);
+
+// Demosaics and remaps the BayerRG8 image with the fixed point maps given by cv::convertMaps (CV_16SC2, CV_16UC1).
+// The result matches cv::cvtColor with cv::COLOR_BayerRG2RGB followed by cv::remap with cv::INTER_LINEAR,
+// up to the rounding and the handling of the borders.
+// The rows of the destination are processed in parallel.
+void bayerRemap(const uint8_t *bayer, int height, int width, const cv::Mat &map_1, const cv::Mat &map_2, cv::Mat &dst);
+
+// Half resolution demosaicing: each RGGB block of 2 x 2 pixels gives one BGR pixel (superpixel).
+// The pixel (i, j) of dst is centred on the position (2 * j + 0.5, 2 * i + 0.5) of the mosaic.
+void bayerSuperpixel(const uint8_t *bayer, int height, int width, cv::Mat &dst);
+
+// Float maps (CV_32FC1) of width columns, the rows in proportion, for the images of bayerSuperpixel.
+// They are the full resolution maps mapX, mapY averaged over the area of each output pixel, with the
+// positions moved to the coordinates of the half resolution image.
+void superpixelMaps(const cv::Mat &mapX, const cv::Mat &mapY, int width, cv::Mat &previewX, cv::Mat &previewY);
+
+} /* namespace ScanVan */
+
+#endif /* BAYERREMAP_HPP_ */
@@ -0,0 +1,37 @@
+//============================================================================
+// Name        : CameraSource.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Selection of the source of the raw images.
+//============================================================================
+
+#include "CameraSource.hpp"
+
+#include <stdexcept>
+
+#ifdef USE_GIGE
+#include "PylonCameraSource.hpp"
+#endif
+#include "SimulatedCameraSource.hpp"
+#include "ReplayCameraSource.hpp"
+
+namespace ScanVan {
+
+std::unique_ptr<ICameraSource> CreateCameraSource(const std::string &type, const CameraSettings &settings) {
+	if (type == "pylon") {
+#ifdef USE_GIGE
+		return std::unique_ptr<ICameraSource>(new PylonCameraSource { settings });
+#else
+		throw std::runtime_error("The program was built without the pylon camera source (USE_GIGE).");
+#endif
+	} else if (type == "simulated") {
+		return std::unique_ptr<ICameraSource>(new SimulatedCameraSource { settings });
+	} else if (type == "replay") {
+		return std::unique_ptr<ICameraSource>(new ReplayCameraSource { settings });
+	} else {
+		throw std::runtime_error("Camera source not recognized: " + type);
+	}
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,96 @@
+//============================================================================
+// Name        : CameraSource.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Interface to the devices that deliver the raw images.
+//				 The Cameras class triggers and retrieves the images through it,
+//				 so the rest of the pipeline runs the same with the Basler GigE
+//				 cameras, with generated images or with a recorded sequence.
+//============================================================================
+
+#ifndef CAMERASOURCE_HPP_
+#define CAMERASOURCE_HPP_
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "ImagesRaw.hpp"
+
+namespace ScanVan {
+
+// Settings read from genparam.cfg that the sources need to configure the devices
+struct CameraSettings {
+	size_t height = 3008;
+	size_t width = 3008;
+
+	double exposureTime = 13057;
+	int64_t gain = 23;
+
+	// offsets of the cameras 0 and 1
+	size_t offsetX_0 = 0;
+	size_t offsetY_0 = 0;
+	size_t offsetX_1 = 0;
+	size_t offsetY_1 = 0;
+
+	// area used by the auto functions
+	size_t aoi_height = 0;
+	size_t aoi_width = 0;
+	size_t aoi_offsetX_0 = 0;
+	size_t aoi_offsetY_0 = 0;
+	size_t aoi_offsetX_1 = 0;
+	size_t aoi_offsetY_1 = 0;
+
+	int autoTargetVal = 100;
+	bool autoExpTimeCont = true;
+	bool autoGainCont = true;
+
+	bool useExternalTrigger = false;
+	bool useChunkFeatures = true;
+
+	bool loadParam = false;		// when true, the .pfs files under config_path are loaded to the cameras
+	std::string config_path { "./config/" };
+
+	bool zeroCopyGrab = false;	// when true, the images keep the buffers of the device
+	size_t numBuffers = 10;		// number of buffers the devices may keep in flight, all the cameras together
+
+	size_t numCameras = 2;		// number of cameras of the simulated source
+	std::string replay_path { "./data/" };	// directory of the recorded sequence of the replay source
+};
+
+class ICameraSource {
+public:
+	// Opens the devices and starts the acquisition
+	virtual void Open() = 0;
+
+	virtual size_t GetNumCam() const = 0;
+
+	// Serial number of the camera with the index idx, the cameras are sorted by serial number
+	virtual std::string GetSerialNumber(size_t idx) const = 0;
+
+	// Requests one image from all the cameras
+	virtual void Trigger() = 0;
+
+	// Fills img0 and img1 with the images of the cameras 0 and 1.
+	// The images come with their size and camera data set, and with a buffer from the frame pool
+	// unless ProvidesBuffers is true, and with the capture time of the CPU of their software trigger (0 with
+	// the external trigger). Only the images of the existing cameras are filled.
+	// Returns false if the source has no more images. Throws std::runtime_error if the retrieval fails.
+	virtual bool Retrieve(ImagesRaw &img0, ImagesRaw &img1) = 0;
+
+	// True if the images use buffers owned by the source instead of the frame pool
+	virtual bool ProvidesBuffers() const { return false; };
+
+	// Saves the configuration of the devices under path, if the source supports it
+	virtual void SaveParameters(const std::string &path) {};
+
+	virtual ~ICameraSource() {};
+};
+
+// Creates the source selected in genparam.cfg: "pylon", "simulated" or "replay"
+std::unique_ptr<ICameraSource> CreateCameraSource(const std::string &type, const CameraSettings &settings);
+
+} /* namespace ScanVan */
+
+#endif /* CAMERASOURCE_HPP_ */
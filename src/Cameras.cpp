@@ -10,13 +10,10 @@
 //============================================================================
 
 #include "Cameras.hpp"
+#include "BayerRemap.hpp"
 
 // The code assumes there are two cameras connected
 
-// Settings to use Basler GigE cameras.
-using namespace Basler_GigECameraParams;
-// Namespace for using pylon objects.
-using namespace Pylon;
 // Namespace for using cout.
 using namespace std;
 
@@ -42,280 +39,122 @@ Cameras::Cameras(std::string path_to_config_files): config_path { path_to_config
 	LoadMap();
 }
 
-void Cameras::Init() {
-
-	CTlFactory& tlFactory = CTlFactory::GetInstance();
-	pTL = dynamic_cast<IGigETransportLayer*>(tlFactory.CreateTl(BaslerGigEDeviceClass));
-	if (pTL == nullptr) {
-		throw RUNTIME_EXCEPTION("No GigE transport layer available.");
-	}
-
-	// In this sample we use the transport layer directly to enumerate cameras.
-	// By calling EnumerateDevices on the TL we get get only GigE cameras.
-	// You could also accomplish this by using a filter and
-	// let the Transport Layer Factory enumerate.
-	DeviceInfoList_t allDeviceInfos { };
-	if (pTL->EnumerateDevices(allDeviceInfos) == 0) {
-		throw RUNTIME_EXCEPTION("No GigE cameras present.");
-	}
-
-	// Only use cameras in the same subnet as the first one.
-	DeviceInfoList_t usableDeviceInfos { };
-	usableDeviceInfos.push_back(allDeviceInfos[0]);
-	subnet = static_cast<const CBaslerGigEDeviceInfo&>(allDeviceInfos[0]).GetSubnetAddress();
-
-	// Start with index 1 as we have already added the first one above.
-	// We will also limit the number of cameras to c_maxCamerasToUse.
-	for (size_t i = 1; i < allDeviceInfos.size() && usableDeviceInfos.size() < c_maxCamerasToUse; ++i) {
-		const CBaslerGigEDeviceInfo& gigeinfo = static_cast<const CBaslerGigEDeviceInfo&>(allDeviceInfos[i]);
-		if (subnet == gigeinfo.GetSubnetAddress()) {
-			// Add this deviceInfo to the ones we will be using.
-			usableDeviceInfos.push_back(gigeinfo);
-		} else {
-			cerr << "Camera will not be used because it is in a different subnet " << subnet << "!" << endl;
-		}
-	}
-
-	// Check if all the cameras have been detected
-	if (usableDeviceInfos.size() > c_maxCamerasToUse) {
-		throw std::runtime_error("More than maxCamerasToUse cameras detected!");
-	}
-	if (usableDeviceInfos.size() > c_maxCamerasToUse) {
-		std::cerr << "Not all the cameras have been detected!" << std::endl;
-	}
-
-	cameras.Initialize(usableDeviceInfos.size());
-
-	// Seed the random number generator and generate a random device key value.
-	srand((unsigned) time(nullptr));
-	DeviceKey = rand();
-
-	// For the following sample we use the CActionTriggerConfiguration to configure the camera.
-	// It will set the DeviceKey, GroupKey and GroupMask features. It will also
-	// configure the camera FrameTrigger and set the TriggerSource to the action command.
-	// You can look at the implementation of CActionTriggerConfiguration in <pylon/gige/ActionTriggerConfiguration.h>
-	// to see which features are set.
-
-	// vector of serial number to sort and order the camera idx
-	struct SerialNumIdx {
-		String_t number;
-		size_t index;
-	};
-	std::vector<SerialNumIdx> sn{};
-
-	// Create all GigE cameras and attach them to the InstantCameras in the array.
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		cameras[i].Attach(tlFactory.CreateDevice(usableDeviceInfos[i]));
-		// We'll use the CActionTriggerConfiguration, which will set up the cameras to wait for an action command.
-		if (useExternalTrigger == false) {
-			cameras[i].RegisterConfiguration(new CActionTriggerConfiguration { DeviceKey, GroupKey, AllGroupMask }, RegistrationMode_Append,
-					Cleanup_Delete);
-		}
-		// Set the context. This will help us later to correlate the grab result to a camera in the array.
-		cameras[i].SetCameraContext(i);
-
-		const CBaslerGigEDeviceInfo& di = cameras[i].GetDeviceInfo();
-
-		// Print the model name of the camera.
-		cout << "Using camera " << i << ": " << di.GetModelName() << " (" << di.GetIpAddress() << ")" << " - (SN:" << di.GetSerialNumber() << ")" << endl;
-
-		SerialNumIdx elem {di.GetSerialNumber(), i};
-		// push the serial numbers and the idx positions into vectors
-		sn.push_back(elem);
-	}
-
-	// Sort the serial numbers in increasing value
-	std::sort(sn.begin(), sn.end(), [](const auto &e1, const auto &e2) {
-		return e1.number < e2.number;
-	});
+CameraSettings Cameras::GetSettings() const {
+// Collects the settings read from genparam.cfg that the source of the images needs
+	CameraSettings settings { };
+	settings.height = height;
+	settings.width = width;
+	settings.exposureTime = exposureTime;
+	settings.gain = gain;
+	settings.offsetX_0 = offsetX_0;
+	settings.offsetY_0 = offsetY_0;
+	settings.offsetX_1 = offsetX_1;
+	settings.offsetY_1 = offsetY_1;
+	settings.aoi_height = aoi_height;
+	settings.aoi_width = aoi_width;
+	settings.aoi_offsetX_0 = aoi_offsetX_0;
+	settings.aoi_offsetY_0 = aoi_offsetY_0;
+	settings.aoi_offsetX_1 = aoi_offsetX_1;
+	settings.aoi_offsetY_1 = aoi_offsetY_1;
+	settings.autoTargetVal = autoTargetVal;
+	settings.autoExpTimeCont = autoExpTimeCont;
+	settings.autoGainCont = autoGainCont;
+	settings.useExternalTrigger = useExternalTrigger;
+	settings.useChunkFeatures = useChunkFeatures;
+	settings.loadParam = loadParam;
+	settings.config_path = config_path;
+	settings.zeroCopyGrab = zeroCopyGrab;
+	settings.numBuffers = framePoolSize;
+	settings.replay_path = replay_path;
+	return settings;
+}
 
-	// Store the indices of the camera corresponding to the increasing value of serial numbers
-	for (const auto &x : sn) {
-		sortedCameraIdx.push_back(x.index);
-	}
+size_t Cameras::RequiredFrameBuffers() const {
+// Number of images the pipeline may hold at once, one per image in the queues plus the ones being processed:
+// the storage queue, the pairs taken by a batch, the slots of the display mailbox, the pairs being grabbed,
+// displayed and stored, and the files of the asynchronous writer, each one holds a single image.
+// With the zero copy grab they are the buffers of the device, the grab times out if they are all in use.
 
-	// Open all cameras.
-	// This will apply the CActionTriggerConfiguration specified above.
-	cameras.Open();
-
-	// Reads the camera parameters from file
-	if (loadParam) {
-		try {
-			LoadParameters();
-		} catch (const GenericException &e) {
-			// Error handling
-			cerr << "Error loading the parameters of the camera." << std::endl;
-			cerr <<  e.GetDescription() << endl;
-		}
+	size_t pairs = storageQueueCapacity + spsc_mailbox<PairImages>::num_slots + 4;
+	if (storeBatch || (storageThreads != 1) || asyncWrites) {
+		// Same condition as StoreImages
+		pairs += storeBatchSize;
 	}
+	return 2 * pairs + ((asyncWrites) ? writesInFlight : 0);
+}
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		// This sets the transfer pixel format to BayerRG8
-		cameras[i].PixelFormat.SetValue(PixelFormat_BayerRG8);
-
-		cameras[i].GevSCPSPacketSize.SetValue(8192);
-		//cameras[i].GevSCPSPacketSize.SetValue(9000);
-		cameras[i].GevSCPD.SetValue(3500); // Inter-packet delay
-		//cameras[i].GevSCPD.SetValue(20); // Inter-packet delay
-		//cameras[i].GevSCFTD.SetValue(0); // Frame-transmission delay
-        if (i==0)
-            cameras[i].GevSCFTD.SetValue(0); // Frame-transmission delay
-        else
-            cameras[i].GevSCFTD.SetValue(2000); // Frame-transmission delay
-
-		cameras[i].GevSCBWRA.SetValue(cameras[i].GevSCBWRA.GetMax());
-
-		cameras[i].GainAuto.SetValue(GainAuto_Off);
-		cameras[i].ExposureAuto.SetValue(ExposureAuto_Off);
-
-		cameras[i].ExposureTimeAbs.SetValue(exposureTime);
-		cameras[i].GainRaw.SetValue(gain);
+void Cameras::Init() {
+// Opens the source of the images and allocates the frame pool
 
-		cameras[i].Width.SetValue(100);
-		cameras[i].Height.SetValue(100);
+	if (framePoolSize == 0) {
+		framePoolSize = RequiredFrameBuffers();
+	} else if (framePoolSize < RequiredFrameBuffers()) {
+		std::cerr << "The frame pool size " << framePoolSize << " is below the " << RequiredFrameBuffers()
+				<< " images the queues may hold, the grab may wait for free buffers." << std::endl;
 	}
+	std::cout << "Frame buffers: " << framePoolSize << std::endl;
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		if (i == 0) {
-			if (IsWritable(cameras[sortedCameraIdx[0]].OffsetX)) {
-				cameras[sortedCameraIdx[0]].OffsetX.SetValue(offsetX_0);
-			}
-			if (IsWritable(cameras[sortedCameraIdx[0]].OffsetY)) {
-				cameras[sortedCameraIdx[0]].OffsetY.SetValue(offsetY_0);
-			}
-		} else if (i == 1) {
-			if (IsWritable(cameras[sortedCameraIdx[1]].OffsetX)) {
-				cameras[sortedCameraIdx[1]].OffsetX.SetValue(offsetX_1);
-			}
-
-			if (IsWritable(cameras[sortedCameraIdx[1]].OffsetY)) {
-				cameras[sortedCameraIdx[1]].OffsetY.SetValue(offsetY_1);
-			}
-		}
+	if ((sourceType != "pylon") && (useExternalTrigger == true)) {
+		std::cerr << "The external trigger is only available with the pylon source, the images are triggered by software." << std::endl;
+		useExternalTrigger = false;
 	}
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+	source = CreateCameraSource(sourceType, GetSettings());
+	source->Open();
 
-		cameras[i].Width.SetValue(width);
-		cameras[i].Height.SetValue(height);
+	// When the images use the buffers of the source (zero copy grab) the pool stays empty
+	framePool = FramePool::create(height * width, (source->ProvidesBuffers()) ? 0 : framePoolSize);
 
-		cameras[i].AutoFunctionAOISelector.SetValue(AutoFunctionAOISelector_AOI1);
-		cameras[i].AutoFunctionAOIWidth.SetValue(aoi_width);
-		cameras[i].AutoFunctionAOIHeight.SetValue(aoi_height);
+	if (storageFormat == "sequence") {
+		sequenceWriter.reset(new SequenceWriter { data_path, segmentSizeMB << 20 });
+	} else if (storageFormat != "files") {
+		throw std::runtime_error("Unknown storage format " + storageFormat + ", expected files or sequence.");
 	}
-
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		if (i == 0) {
-			cameras[sortedCameraIdx[0]].AutoFunctionAOIOffsetX.SetValue(aoi_offsetX_0);
-			cameras[sortedCameraIdx[0]].AutoFunctionAOIOffsetY.SetValue(aoi_offsetY_0);
-		} else if (i == 1) {
-			cameras[sortedCameraIdx[1]].AutoFunctionAOIOffsetX.SetValue(aoi_offsetX_1);
-			cameras[sortedCameraIdx[1]].AutoFunctionAOIOffsetY.SetValue(aoi_offsetY_1);
+	if (rawCompression) {
+		if (sequenceWriter) {
+			std::cerr << "The sequences hold the images uncompressed, the raw compression is ignored." << std::endl;
+		} else {
+			rawCodec.reset(new BayerCodec { compressionThreads });
+			std::cout << "Compression threads: " << rawCodec->getNumThreads() << std::endl;
 		}
 	}
-
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-
-		cameras[i].AutoTargetValue.SetValue(autoTargetVal);
-
-		// Sets auto adjustments continuous
-		if (autoExpTimeCont)
-			cameras[i].ExposureAuto.SetValue(ExposureAuto_Continuous);
-		if (autoGainCont)
-			cameras[i].GainAuto.SetValue(GainAuto_Continuous);
-	}
-
-	if (useExternalTrigger == true) {
-		// Configuration for external trigger
-		for (size_t i = 0; i < cameras.GetSize(); ++i) {
-			cameras[i].AcquisitionMode.SetValue(AcquisitionMode_Continuous);
-			//cameras[i].TriggerSelector.SetValue(TriggerSelector_AcquisitionStart);
-			cameras[i].TriggerSelector.SetValue(TriggerSelector_FrameStart);
-			cameras[i].TriggerMode.SetValue(TriggerMode_On);
-			cameras[i].TriggerSource.SetValue(TriggerSource_Line1);
-			cameras[i].TriggerActivation.SetValue(TriggerActivation_RisingEdge);
+	if (storageThreads != 1) {
+		if (sequenceWriter) {
+			// The pairs are appended in their order and there is nothing to encode
+			std::cerr << "The sequences are written by a single thread, the storage threads are ignored." << std::endl;
+		} else {
+			storagePool.reset(new ThreadPool { (storageThreads == 0) ? std::max<size_t>(1, std::thread::hardware_concurrency()) : storageThreads });
+			std::cout << "Storage threads: " << storagePool->size() << std::endl;
 		}
 	}
-
-	if (useChunkFeatures == true) {
-		// Configuration for chunk features
-		for (size_t i = 0; i < cameras.GetSize(); ++i) {
-
-			// Enable chunks in general.
-	        if (GenApi::IsWritable(cameras[i].ChunkModeActive))
-	        {
-	            cameras[i].ChunkModeActive.SetValue(true);
-	        }
-	        else
-	        {
-	            throw RUNTIME_EXCEPTION( "The camera doesn't support chunk features");
-	        }
-
-	        // Enable time stamp chunks.
-	        cameras[i].ChunkSelector.SetValue(ChunkSelector_Timestamp);
-			cameras[i].ChunkEnable.SetValue(true);
-			cameras[i].ChunkSelector.SetValue(ChunkSelector_ExposureTime);
-			cameras[i].ChunkEnable.SetValue(true);
-			cameras[i].ChunkSelector.SetValue(ChunkSelector_GainAll);
-			cameras[i].ChunkEnable.SetValue(true);
-		}
+	if (storeEquirect && sequenceWriter) {
+		std::cerr << "The sequences hold the raw images, the equirectangular storage is ignored." << std::endl;
+		storeEquirect = false;
 	}
-
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		if (i == 0) {
-			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
-			balanceR_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
-			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
-			balanceG_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
-			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
-			balanceB_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
-		} else if (i == 1) {
-			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
-			balanceR_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
-			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
-			balanceG_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
-			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
-			balanceB_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
+	imageEncoding.validate();
+	if (asyncWrites) {
+		if (sequenceWriter) {
+			std::cerr << "The sequences are written by the storage thread, the asynchronous writes are ignored." << std::endl;
+		} else {
+			asyncWriter.reset(new AsyncWriter { writesInFlight });
+			std::cout << "Asynchronous writes: " << asyncWriter->getBackend() << ", " << asyncWriter->getDepth() << " in flight" << std::endl;
 		}
 	}
-
-
-	// Starts grabbing for all cameras.
-	// The cameras won't transmit any image data, because they are configured to wait for an action command.
-
-	cameras.StartGrabbing();
-
 }
 
 void Cameras::IssueActionCommand() {
-	//////////////////////////////////////////////////////////////////////
-	//////////////////////////////////////////////////////////////////////
-	// Use an Action Command to Trigger Multiple Cameras at the Same Time.
-	//////////////////////////////////////////////////////////////////////
-	//////////////////////////////////////////////////////////////////////
+// Triggers all the cameras at the same time and signals the grabbing procedure
 	cout << endl << "Issuing an action command." << endl;
 
 	try {
 
-//		const int DefaultTimeout_ms { 5000 };
+		int64_t captureTimeCPU = StampTime();
 
-		std::string captureTimeCPU = StampTime();
-
-		// Now we issue the action command to all devices in the subnet.
-		// The devices with a matching DeviceKey, GroupKey and valid GroupMask will grab an image.
-		pTL->IssueActionCommand(DeviceKey, GroupKey, AllGroupMask, subnet);
+		source->Trigger();
 
 		// If the action command is successful push the time stamp for retrieving the image
 		triggerQueue.push ( captureTimeCPU );
 
-//		cameras[0].WaitForFrameTriggerReady(DefaultTimeout_ms, TimeoutHandling_ThrowException);
-//		cameras[1].WaitForFrameTriggerReady(DefaultTimeout_ms, TimeoutHandling_ThrowException);
-
-	} catch (const GenericException &e) {
-		// Error handling
-		cerr << "=============================================================" << endl;
-		cerr << "An exception occurred." << endl << e.GetDescription() << endl;
-		cerr << "=============================================================" << endl;
 	} catch (const std::exception &e) {
 		cerr << "=============================================================" << endl;
 		cerr << "An exception occurred." << endl << e.what() << endl;
@@ -324,155 +163,71 @@ void Cameras::IssueActionCommand() {
 
 }
 
-void Cameras::GrabImages() {
+bool Cameras::GrabImages() {
+// Grabs one pair of images and pushes it into the storage queue, while recording, and into the display queue
+// Returns true if a pair was grabbed
 
 	std::chrono::high_resolution_clock::time_point t1 { };
 	std::chrono::high_resolution_clock::time_point t2 { };
 
 	try {
 
-		std::string captureTimeCPU {};
+		int64_t captureTimeCPU { };
 
 		if (useExternalTrigger == false) {
-			std::shared_ptr<std::string> timeStamp { };
-			timeStamp = triggerQueue.wait_pop();
-			captureTimeCPU = *timeStamp;
+			// Returns false on timeout or when the trigger queue was closed and emptied
+			if (triggerQueue.wait_pop_for(captureTimeCPU, std::chrono::milliseconds(500)) == false) {
+				return false;
+			}
+		} else if (exitProgram) {
+			return false;
 		}
 
-		const int DefaultTimeout_ms { 5000 };
-
-		// This smart pointer will receive the grab result data.
-		CBaslerGigEGrabResultPtr ptrGrabResult { };
+		size_t numCam = source->GetNumCam();
+		bool useFramePool = !source->ProvidesBuffers();
 
 		// Create an Image objects for the grabbed data
-		ImagesRaw img0 {};
-		ImagesRaw img1 {};
+		// The buffers are borrowed from the frame pool, if it is exhausted they are allocated on the heap
+		// When the source provides the buffers they are attached at the retrieval
+		ImagesRaw img0 { height, width, ((numCam >= 1) && useFramePool) ? framePool->acquire() : std::shared_ptr<FrameBuffer> { } };
+		ImagesRaw img1 { height, width, ((numCam == 2) && useFramePool) ? framePool->acquire() : std::shared_ptr<FrameBuffer> { } };
 
-		if (cameras.GetSize() >= 1) {
+		if (numCam >= 1) {
 			img0.setCameraIdx(0);
-			//img0.setCaptureTime(captureTime);
-//			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
-//			img0.setBalanceR(cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue());
-//			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
-//			img0.setBalanceG(cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue());
-//			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
-//			img0.setBalanceB(cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue());
 			img0.setAutoExpTime(static_cast<int>(autoExpTimeCont));
 			img0.setAutoGain(static_cast<int>(autoGainCont));
-			std::stringstream ss1 { };
-			std::string tstr1 { };
-			ss1 << cameras[sortedCameraIdx[0]].GetDeviceInfo().GetSerialNumber().c_str();
-			ss1 >> tstr1;
-			img0.setSerialNumber(tstr1);
+			img0.setSerialNumber(source->GetSerialNumber(0));
 		}
 
-		if (cameras.GetSize() == 2) {
+		if (numCam == 2) {
 			img1.setCameraIdx(1);
-			//img1.setCaptureTime(captureTime);
-//			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
-//			img1.setBalanceR(cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue());
-//			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
-//			img1.setBalanceG(cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue());
-//			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
-//			img1.setBalanceB(cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue());
 			img1.setAutoExpTime(static_cast<int>(autoExpTimeCont));
 			img1.setAutoGain(static_cast<int>(autoGainCont));
-			std::stringstream ss2 { };
-			std::string tstr2 { };
-			ss2 << cameras[sortedCameraIdx[1]].GetDeviceInfo().GetSerialNumber().c_str();
-			ss2 >> tstr2;
-			img1.setSerialNumber(tstr2);
+			img1.setSerialNumber(source->GetSerialNumber(1));
 		}
 
+		// The time of the trigger goes with the images, the source may stamp the camera time from it (simulated)
+		img0.setCaptureCPUTime(captureTimeCPU);
+		img1.setCaptureCPUTime(captureTimeCPU);
+
 		// Retrieve images from all cameras.
 
 		t1 = std::chrono::high_resolution_clock::now();
 
-		for (size_t i = 0; i < cameras.GetSize() && cameras.IsGrabbing(); ++i) {
-
-			std::string captureTimeCam {};
-			double exposureTime {};
-			int gain {};
-
-			// CInstantCameraArray::RetrieveResult will return grab results in the order they arrive.
-			cameras.RetrieveResult(DefaultTimeout_ms, ptrGrabResult, TimeoutHandling_ThrowException);
-
-			// When the cameras in the array are created the camera context value
-			// is set to the index of the camera in the array.
-			// The camera context is a user-settable value.
-			// This value is attached to each grab result and can be used
-			// to determine the camera that produced the grab result.
-			intptr_t cameraIndex = ptrGrabResult->GetCameraContext();
-
-			// Image grabbed successfully?
-			if (ptrGrabResult->GrabSucceeded()) {
-				// Print the index and the model name of the camera.
-				cout << "Camera " << sortedCameraIdx[cameraIndex] << ": " << cameras[cameraIndex].GetDeviceInfo().GetModelName() << " ("
-						<< cameras[cameraIndex].GetDeviceInfo().GetIpAddress() << ") (SN:" << cameras[cameraIndex].GetDeviceInfo().GetSerialNumber()
-						<< ")" << endl;
-				// You could process the image here by accessing the image buffer.
-				cout << "GrabSucceeded: " << ptrGrabResult->GrabSucceeded() << endl;
-				uint8_t *pImageBuffer = static_cast<uint8_t *>(ptrGrabResult->GetBuffer());
-
-				if (useExternalTrigger == true) {
-					captureTimeCPU = StampTime();
-				}
-
-				if (useChunkFeatures == true) {
-					// Check to see if a buffer containing chunk data has been received.
-					if (PayloadType_ChunkData != ptrGrabResult->GetPayloadType()) {
-						throw RUNTIME_EXCEPTION( "Unexpected payload type received.");
-					}
-
-		            // Access the chunk data attached to the result.
-		            // Before accessing the chunk data, you should check to see
-		            // if the chunk is readable. When it is readable, the buffer
-		            // contains the requested chunk data.
-		            if (IsReadable(ptrGrabResult->ChunkTimestamp)) {
-		            	std::ostringstream oss{};
-		            	oss << ptrGrabResult->ChunkTimestamp.GetValue();
-		            	captureTimeCam = oss.str();
-		                cout << "TimeStamp (Result): " << captureTimeCam << endl;
-		            }
-					if (IsReadable(ptrGrabResult->ChunkExposureTime)) {
-						exposureTime = ptrGrabResult->ChunkExposureTime.GetValue();
-						cout << "ExposureTime (Result): " << exposureTime << endl;
-					}
-					if (IsReadable(ptrGrabResult->ChunkGainAll)) {
-						gain = ptrGrabResult->ChunkGainAll.GetValue();
-						cout << "Gain (Result): " << gain << endl;
-					}
-				}
-
-				// Copy image to the object's buffer
-				if (sortedCameraIdx[cameraIndex] == 0) {
-					img0.copyBuffer(reinterpret_cast<char *>(pImageBuffer));
-					img0.setCaptureCPUTime(captureTimeCPU);
-					img0.setCaptureCamTime(captureTimeCam);
-					img0.setExposureTime(exposureTime);
-					img0.setGain(gain);
-					img0.setBalanceR(balanceR_0);
-					img0.setBalanceG(balanceG_0);
-					img0.setBalanceB(balanceB_0);
-				} else {
-					img1.copyBuffer(reinterpret_cast<char *>(pImageBuffer));
-					img1.setCaptureCPUTime(captureTimeCPU);
-					img1.setCaptureCamTime(captureTimeCam);
-					img1.setExposureTime(exposureTime);
-					img1.setGain(gain);
-					img1.setBalanceR(balanceR_1);
-					img1.setBalanceG(balanceG_1);
-					img1.setBalanceB(balanceB_1);
-				}
-
-				cout << "Gray value of first pixel: " << static_cast<uint32_t>(pImageBuffer[0]) << endl << endl;
-			} else {
-				// If a buffer has been incompletely grabbed, the network bandwidth is possibly insufficient for transferring
-				// multiple images simultaneously. See note above c_maxCamerasToUse.
-				cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << endl;
-				throw std::runtime_error ("Buffer was incompletely grabbed.");
+		if (source->Retrieve(img0, img1) == false) {
+			// The source has no more images, e.g. the end of a replayed sequence. The triggers still queued
+			// land here too, the message is printed by the first one.
+			if (!exitProgram.exchange(true)) {
+				std::cout << "No more images from the source." << std::endl;
 			}
+			return false;
+		}
+
+		if (useExternalTrigger == true) {
+			captureTimeCPU = StampTime();
 		}
+		img0.setCaptureCPUTime(captureTimeCPU);
+		img1.setCaptureCPUTime(captureTimeCPU);
 
 		t2 = std::chrono::high_resolution_clock::now();
 
@@ -480,93 +235,44 @@ void Cameras::GrabImages() {
 		number_grab_int++;
 
 		PairImages imgs2store { std::move(img0), std::move(img1) };
-		imgDisplayQueue.push(imgs2store);
-
-
-		// In case you want to trigger again you should wait for the camera
-		// to become trigger-ready before issuing the next action command.
-		// To avoid overtriggering you should call cameras[0].WaitForFrameTriggerReady
-		// (see Grab_UsingGrabLoopThread sample for details).
+		if (startSaving) {
+			// The storage gets every pair, it blocks the grab when the disk falls behind.
+			// Both copies share the buffers of the images (copy on write), nothing is copied.
+			++imgNum; // increase the image number;
+			imgs2store.setImgNumber(imgNum);
+			imgStorageQueue.push(PairImages { imgs2store });
+		}
+		// The display gets what it can keep up with, the oldest pair is dropped
+		imgDisplayQueue.push(std::move(imgs2store));
 
-	} catch (const GenericException &e) {
-		// Error handling
-		cerr << "=============================================================" << endl;
-		cerr << "An exception occurred." << endl << e.GetDescription() << endl;
-		cerr << "=============================================================" << endl;
 	} catch (const std::exception &e) {
 		cerr << "=============================================================" << endl;
 		cerr << "An exception occurred." << endl << e.what() << endl;
 		cerr << "=============================================================" << endl;
+		return false;
 	}
 
+	return true;
 }
 
-
-
-
-#include "EquiToPinhole.hpp"
-
-
-
-template<typename T>
-inline void polar2Spherical (const T &theta, const T &phi, cv::Matx<T,1,3> &p) {
-// Converts polar coordinates to spherical coordinates
-// Inputs:
-//		theta: scans on the x-y direction and is in the range [0,2pi]
-//		phi: scans on the z direction and is in the range [-pi/2, pi/2]
-// Output:
-//		p: the point in spherical coordinates
-
-	// coordinate conversion
-	p(0) = static_cast<T>(cos(theta) * cos(phi));
-	p(1) = static_cast<T>(sin(theta) * cos(phi));
-	p(2) = static_cast<T>(sin(phi));
+bool Cameras::GrabFinished() {
+// The grabbing is finished when the trigger queue has been closed and emptied,
+// or, with the external trigger, when the exit of the program has been requested
+	if (useExternalTrigger == false) {
+		return triggerQueue.is_closed() && triggerQueue.empty();
+	} else {
+		return exitProgram;
+	}
 }
 
-template<typename T>
-inline void Spherical2Polar (const cv::Matx<T,1,3> &v, T &theta, T &phi){
-// Converts from spherical coordinates to polar coordinates
-// Input:
-//	v	: spherical coordinates
-// Outputs:
-//	theta	: the angle that corresponds to the x-direction on an equirectangular image, it goes from 0 (left) to 2pi (right)
-// 	rho		: the angle that corresponds to the y-direction on an equirectangular image, it goes from pi/2 (top) to -pi/2 (bottom)
-//
-// Remarks:
-//
-//		    y
-//         pi/2
-//	    	|
-//		    |
-//   pi ----------- 0 x
-//   		|
-// 	    	|
-//     	  3/2*pi
-//
-//			z
-//		   pi/2
-// 			|
-//          |
-//  -----------------
-//			|
-//			|
-//		  -pi/2
 
-	const T &x = v(0);
-	const T &y = v(1);
-	const T &z = v(2);
 
-	phi = asin(z);
 
-	T h = sqrt(x * x + y * y);
+#include "EquiToPinhole.hpp"
+#include "MapRotation.hpp"
+#include "PinholeRenderer.hpp"
 
-	if (y >= 0) {
-		theta = acos(x / h);
-	} else {
-		theta = 2 * M_PI - acos(x / h);
-	}
 
-}
 
 //void mapToVec2f(cv:Vec2s &m1, short &m2, float &u, float &v){
 //    m1[j*2] = (short)(iu >> cv::INTER_BITS);
@@ -583,45 +289,6 @@ inline void Spherical2Polar (const cv::Matx<T,1,3> &v, T &theta, T &phi){
 //}
 
 
-void rotateMap(cv::Mat &mapX, cv::Mat &mapY, cv::Mat &mapXRot, cv::Mat &mapYRot, float alpha){
-//	alpha = 0;
-	int w = mapX.cols, h = mapX.rows;
-	for(int y = 0; y < mapX.rows;y++){
-		for(int x = 0; x < mapX.cols;x++){
-			float theta = M_PI*x/w-M_PI/2;
-			float phi   = M_PI/2-M_PI*y/h;
-			cv::Matx13f s;
-			polar2Spherical<float>(theta, phi, s);
-			cv::Matx13f sRot;
-			sRot(1) = s(1) * cos(alpha) - s(2) * sin(alpha);
-			sRot(2) = s(1) * sin(alpha) + s(2) * cos(alpha);
-			sRot(0) = s(0);
-			float thetaRot;
-			float phiRot;
-			Spherical2Polar<float>(sRot, thetaRot, phiRot);
-			float xRot = (thetaRot+M_PI/2)*w/M_PI;
-			float yRot = (M_PI/2-phiRot)*h/M_PI;
-			if(x == 1000 && y == 3008/2){
-				int xs = 2;
-			}
-			int xi = (int)xRot %(w), yi = (int)yRot %(h);
-			if(xi > 0 && xi < w-1 && yi > 0 && yi < h-1){
-				float xfb = xRot-((int)xRot), yfb = yRot-((int)yRot);
-				float xfa = 1.0f-xfb, yfa = 1.0f-yfb;
-				mapXRot.at<float>(y, x) = (mapX.at<float>(yi, xi)*xfa + mapX.at<float>(yi, xi+1)*xfb)*yfa + (mapX.at<float>(yi+1, xi)*xfa + mapX.at<float>(yi+1, xi+1)*xfb)*yfb;
-				mapYRot.at<float>(y, x) = (mapY.at<float>(yi, xi)*xfa + mapY.at<float>(yi, xi+1)*xfb)*yfa + (mapY.at<float>(yi+1, xi)*xfa + mapY.at<float>(yi+1, xi+1)*xfb)*yfb;
-			} else {
-				mapXRot.at<float>(y, x) = 0;
-				mapYRot.at<float>(y, x) = 0;
-			}
-//			mapXRot.at<float>(y, x) = mapX.at<float>(yi, xi);
-//			mapYRot.at<float>(y, x) = mapY.at<float>(yi, xi);
-
-
-		}
-	}
-}
-
 string type2str(int type) {
   string r;
 
@@ -662,46 +329,55 @@ void rotCalibClick(int event, int x, int y, int flags, void* userdata)
 
 
 
-void Cameras::DisplayImages() {
+bool Cameras::DisplayImages() {
+// Displays the latest pair of images grabbed
+// Returns true if a pair was displayed
 	int key { };
-	std::shared_ptr<PairImages> imgs { };
-	imgs = imgDisplayQueue.wait_pop();
+	PairImages imgs { };
+	if (imgDisplayQueue.wait_pop_for(imgs, std::chrono::milliseconds(100)) == false) {
+		// Keeps the windows responsive and the ESC key working while no images arrive
+		if (imgDisplayQueue.is_closed() == false) {
+			key = cv::waitKey(1);
+			if (key == 27) {
+				exitProgram = true;
+			}
+		}
+		return false;
+	}
 
 	std::chrono::high_resolution_clock::time_point t1{};
 	std::chrono::high_resolution_clock::time_point t2{};
 
 	t1 = std::chrono::high_resolution_clock::now();
-	PairImages imgs2 {*imgs};
-	imgs2.convertRaw2CV();
-	t2 = std::chrono::high_resolution_clock::now();
-
-	total_duration_raw2cv += t2 - t1;
-	number_conversions_raw2cv++;
-
-	std::chrono::high_resolution_clock::time_point t3 { };
-	std::chrono::high_resolution_clock::time_point t4 { };
-
-	t3 = std::chrono::high_resolution_clock::now();
-	PairImages imgs3 {imgs2};
-
+	PairImages imgs3 {imgs};
 
-	imgs3.convertCV2Equi(map_0_1s, map_0_2s, map_1_1s, map_1_2s);
+	if ((previewWidth > 0) && (!pineholeDisplayEnable)) {
+		// Half resolution demosaicing and remap to the small maps, the full resolution is left to the storage
+		imgs3.convertRaw2Preview(*remapEngine, previewMap, displayInterpolation);
+	} else {
+		// Demosaics and remaps straight from the Bayer images. The pinhole views of the rotation calibration
+		// need the full resolution, the steps of the rotation are far below a pixel of the preview.
+		imgs3.convertRaw2Equi(*remapEngine, displayInterpolation);
+	}
 	imgs3.showPairConcat();
 
+	t2 = std::chrono::high_resolution_clock::now();
 
-	t4 = std::chrono::high_resolution_clock::now();
-
-	total_duration_cv2equi += t4 - t3;
-	number_conversions_cv2equi++;
+	total_duration_raw2equi += t2 - t1;
+	number_conversions_raw2equi++;
 
 
 
 
 	if(pineholeDisplayEnable){
 		cv::Mat concat = imgs3.rgbConcat();
-		cv::Mat pinhole1(1000, 1000, CV_8UC3), pinhole2(1000, 1000, CV_8UC3);
-		equiToPinhole(concat, pinhole1, 60, 0, 0);
-		equiToPinhole(concat, pinhole2, 60, M_PI, 0);
+		// Front and back views, their maps are computed at the first frame and reused
+		std::vector<PinholeView> views(2);
+		views[1].azim = static_cast<float>(M_PI);
+		std::vector<cv::Mat> pinholes { };
+		pinholeRenderer.render(concat, views, pinholes);
+		cv::Mat &pinhole1 = pinholes[0];
+		cv::Mat &pinhole2 = pinholes[1];
 
 		rotCalibContexts[0].draw(pinhole1);
 		rotCalibContexts[1].draw(pinhole2);
@@ -745,18 +421,25 @@ void Cameras::DisplayImages() {
 //
 //	rotCalibAlpha += M_PI/180;
 	if(genMap){
-		cv::Mat map_1_1_rotf(map_1_1f.rows, map_1_1f.cols, CV_32FC1);
-		cv::Mat map_1_2_rotf(map_1_2f.rows, map_1_2f.cols, CV_32FC1);
-
-		rotateMap(map_1_1f, map_1_2f, map_1_1_rotf, map_1_2_rotf, rotCalibAlpha);
-		cv::convertMaps(map_1_1_rotf, map_1_2_rotf, map_1_1s, map_1_2s, CV_16SC2);
+		if (rotateOnTheFly) {
+			// The rotation is composed into the lookup of the remap engine, the map is not rebuilt
+			remapEngine->setRotation(1, map_1_1f, map_1_2f, rotCalibAlpha);
+			if (previewWidth > 0) {
+				remapEngine->setRotation(previewMap + 1, preview_1_1f, preview_1_2f, rotCalibAlpha);
+			}
+		} else {
+			rotateMapFixed(map_1_1f, map_1_2f, map_1_1s, map_1_2s, rotCalibAlpha);
+			remapEngine->setMaps(1, map_1_1s, map_1_2s);
+			if (previewWidth > 0) {
+				// The small maps are rotated on their own, which costs a fraction of the full ones
+				cv::Mat p1s { };
+				cv::Mat p2s { };
+				rotateMapFixed(preview_1_1f, preview_1_2f, p1s, p2s, rotCalibAlpha);
+				remapEngine->setMaps(previewMap + 1, p1s, p2s);
+			}
+		}
 		imgDisplayQueue.flush();
 		cout << "************** " << rotCalibAlpha << endl;
-		cout << "************** " << rotCalibAlpha << endl;
-		cout << "************** " << rotCalibAlpha << endl;
-		cout << "************** " << rotCalibAlpha << endl;
-		cout << "************** " << rotCalibAlpha << endl;
-		cv::waitKey(200);
 	}
 
 	if(key == '5'){
@@ -770,27 +453,21 @@ void Cameras::DisplayImages() {
 	}
 	if (key == 27) {
 		// if ESC key is pressed signal to exit the program
+		// the pairs still in the queues are processed before the threads finish
 		exitProgram = true;
-		imgStorageQueue.push (*imgs);
-	} else if ((key == 's') || (key == 'S') || startSaving) {
-		++imgNum; // increase the image number;
-		imgs->setImgNumber(imgNum);
-		imgStorageQueue.push (*imgs);
-//		imgs2.setImgNumber(imgNum);
-//		imgStorageQueue.push (imgs2);
-//		imgs3.setImgNumber(imgNum);
-//		imgStorageQueue.push (imgs3);
+	}
+	// The grab sends the pairs to the storage while recording, the display only switches it
+	if ((key == 's') || (key == 'S')) {
 		startSaving = true;
-	} else if ((key == 'c') || (key == 'C') || startSaving) {
-		++imgNum; // increase the image number;
-		imgs->setImgNumber(imgNum);
-		imgStorageQueue.push (*imgs);
-//		imgs2.setImgNumber(imgNum);
-//		imgStorageQueue.push (imgs2);
-//		imgs3.setImgNumber(imgNum);
-//		imgStorageQueue.push (imgs3);
+	} else if ((key == 'c') || (key == 'C')) {
 		startSaving = false;
 	}
+
+	return true;
+}
+
+bool Cameras::DisplayFinished() {
+	return imgDisplayQueue.is_closed() && imgDisplayQueue.empty();
 }
 
 void Cameras::DemoLoadImages() {
@@ -823,68 +500,115 @@ void Cameras::DemoLoadImages() {
 
 }
 
-void Cameras::StoreImages() {
+long int Cameras::StoreImages() {
+// Saves the pairs of images from the storage queue
+// Returns the number of pairs that were processed
+
+	if (storeBatch || storagePool || asyncWriter) {
+		return StoreImagesBatch();
+	}
 
 	std::chrono::high_resolution_clock::time_point t1 { };
 	std::chrono::high_resolution_clock::time_point t2 { };
 
-	std::shared_ptr<PairImages> imgs { };
-	imgs = imgStorageQueue.wait_pop();
-	if (exitProgram != true) {
-		t1 = std::chrono::high_resolution_clock::now();
-		imgs->savePair(data_path);
-		t2 = std::chrono::high_resolution_clock::now();
+	PairImages imgs { };
+	if (imgStorageQueue.wait_pop(imgs) == false) {
+		// The storage queue was closed and all the pairs were saved
+		return 0;
+	}
 
-		if (imgs->getType() == ImgType::RAW) {
-			total_duration_sto_raw += t2 - t1;
-			number_sto_raw++;
-		} else if (imgs->getType() == ImgType::CV) {
-			total_duration_sto_cv += t2 - t1;
-			number_sto_cv++;
-		} else if (imgs->getType() == ImgType::EQUI) {
-			total_duration_sto_equi += t2 - t1;
-			number_sto_equi++;
+	t1 = std::chrono::high_resolution_clock::now();
+	if (sequenceWriter) {
+		imgs.savePair(*sequenceWriter);
+	} else {
+		imgs.savePair(data_path, GetStorageOptions());
+	}
+	t2 = std::chrono::high_resolution_clock::now();
+
+	if (imgs.getType() == ImgType::RAW) {
+		total_duration_sto_raw += t2 - t1;
+		number_sto_raw++;
+	} else if (imgs.getType() == ImgType::CV) {
+		total_duration_sto_cv += t2 - t1;
+		number_sto_cv++;
+	} else if (imgs.getType() == ImgType::EQUI) {
+		total_duration_sto_equi += t2 - t1;
+		number_sto_equi++;
 
-		}
 	}
 
+	return 1;
 }
 
-void Cameras::SaveParameters(){
+long int Cameras::StoreImagesBatch() {
+// Takes all the pairs waiting in the storage queue (up to storeBatchSize) and saves them in one pass.
+// After a stall of the disk the queue is emptied in large bursts instead of one pair per wake-up.
+// With the storage threads the pairs of the batch are encoded and written concurrently (see PairImages::saveBatch).
+// With the asynchronous writes the time is the one of handing the files to the writer.
 
-	std::vector<String_t> sn{};
+	std::chrono::high_resolution_clock::time_point t1 { };
+	std::chrono::high_resolution_clock::time_point t2 { };
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		sn.push_back(cameras[i].GetDeviceInfo().GetSerialNumber());
-		std::stringstream ss{};
-		ss << sn[i].c_str();
-		ss << ".pfs";
-		std::string filename = config_path + "/" + ss.str();
+	std::vector<PairImages> batch = imgStorageQueue.wait_pop_batch(storeBatchSize, std::chrono::milliseconds(100));
 
-		//const char Filename[name.size()+1] { name.c_str() };
-		cout << "Saving camera's node map to file..." << endl;
-		// Save the content of the camera's node map into the file.
-		CFeaturePersistence::Save(filename.c_str(), &cameras[i].GetNodeMap());
+	if (batch.empty()) {
+		return 0;
 	}
 
-}
+	t1 = std::chrono::high_resolution_clock::now();
+	if (sequenceWriter) {
+		PairImages::saveBatch(batch, *sequenceWriter);
+	} else {
+		PairImages::saveBatch(batch, data_path, GetStorageOptions());
+	}
+	t2 = std::chrono::high_resolution_clock::now();
+
+	std::chrono::duration<double> d = std::chrono::duration<double>(t2 - t1) / static_cast<double>(batch.size());
+	for (auto &imgs : batch) {
+		if (imgs.getType() == ImgType::RAW) {
+			total_duration_sto_raw += d;
+			number_sto_raw++;
+		} else if (imgs.getType() == ImgType::CV) {
+			total_duration_sto_cv += d;
+			number_sto_cv++;
+		} else if (imgs.getType() == ImgType::EQUI) {
+			total_duration_sto_equi += d;
+			number_sto_equi++;
+		}
+	}
 
-void Cameras::LoadParameters(){
+	return static_cast<long int>(batch.size());
+}
 
-	std::vector<String_t> sn{};
+StorageOptions Cameras::GetStorageOptions() const {
+	StorageOptions options { };
+	options.codec = rawCodec.get();
+	options.encoding = imageEncoding;
+	options.equirect = storageRemapEngine.get();
+	options.pool = storagePool.get();
+	options.writer = asyncWriter.get();
+	return options;
+}
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		sn.push_back(cameras[i].GetDeviceInfo().GetSerialNumber());
-		std::stringstream ss { };
-		ss << sn[i].c_str();
-		ss << ".pfs";
-		std::string filename = config_path + "/" + ss.str();
+bool Cameras::StorageFinished() {
+	return imgStorageQueue.is_closed() && imgStorageQueue.empty();
+}
 
-	    std::cout << "Reading file back to camera's node map for camera with SN:"<< cameras[i].GetDeviceInfo().GetSerialNumber() << " ..." << std::endl;
-	    CFeaturePersistence::Load(filename.c_str(), &cameras[i].GetNodeMap(), true );
+void Cameras::CloseStorage() {
+// Closes the files of the storage once all the pairs are saved
+	if (asyncWriter) {
+		asyncWriter->drain();
+	}
+	if (sequenceWriter) {
+		sequenceWriter->close();
 	}
 }
 
+void Cameras::SaveParameters(){
+// Saves the configuration of the cameras into config_path, the names of the files are the serial numbers .pfs
+	source->SaveParameters(config_path);
+}
+
 void Cameras::LoadCameraConfig() {
 
 	std::string path_data = config_path + "genparam.cfg";
@@ -943,135 +667,364 @@ void Cameras::LoadCameraConfig() {
 		ss >> path_cal;
 		std::cout << "Path to calibration directory: " << path_cal << std::endl;
 
-		myFile.close();
+		// The following parameters are optional
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			storeBatch = static_cast<bool>(val);
+			std::cout << "Store in batches: " << storeBatch << std::endl;
+		}
 
-	} else {
-		throw std::runtime_error("Could not open the file to load camera data");
-	}
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> storeBatchSize;
+			std::cout << "Store batch size: " << storeBatchSize << std::endl;
+		}
 
-}
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> framePoolSize;
+			std::cout << "Frame pool size: " << framePoolSize << std::endl;
+		}
 
-void Cameras::LoadMap() {
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			zeroCopyGrab = static_cast<bool>(val);
+			std::cout << "Zero copy grab: " << zeroCopyGrab << std::endl;
+		}
 
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> sourceType;
+			std::cout << "Camera source: " << sourceType << std::endl;
+		}
 
-	if (cameras.GetSize() >= 1) {
-		String_t sn1 { };
-		sn1 = cameras[sortedCameraIdx[0]].GetDeviceInfo().GetSerialNumber();
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> replay_path;
+			std::cout << "Replay path: " << replay_path << std::endl;
+		}
 
-		std::stringstream ss1 { };
-		ss1 << path_cal;
-		ss1 << "calibration_";
-		ss1 << sn1.c_str();
-		ss1 << "/map1.xml";
-		std::string filename1 = ss1.str();
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> fps;
+			std::cout << "Trigger rate (fps): " << fps << std::endl;
+		}
 
-		cv::FileStorage file_0_1(filename1, cv::FileStorage::READ);
-		if (file_0_1.isOpened()) {
-			file_0_1["mat_map1"] >> map_0_1f;
-			file_0_1.release();
-			std::cout << "Read " << filename1 << std::endl;
-		} else {
-			throw std::runtime_error("Could not load map_0_1.");
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> remapThreads;
+			std::cout << "Remap threads: " << remapThreads << std::endl;
 		}
 
-		std::stringstream ss2 { };
-		ss2 << path_cal;
-		ss2 << "calibration_";
-		ss2 << sn1.c_str();
-		ss2 << "/map2.xml";
-		std::string filename2 = ss2.str();
-
-		cv::FileStorage file_0_2(filename2, cv::FileStorage::READ);
-		if (file_0_2.isOpened()) {
-			file_0_2["mat_map2"] >> map_0_2f;
-			file_0_2.release();
-			std::cout << "Read " << filename2 << std::endl;
-		} else {
-			throw std::runtime_error("Could not load map_0_2.");
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			std::string name { };
+			ss >> name;
+			displayInterpolation = interpolationFromString(name);
+			std::cout << "Display interpolation: " << interpolationToString(displayInterpolation) << std::endl;
 		}
 
-		cv::convertMaps(map_0_1f, map_0_2f, map_0_1s, map_0_2s, CV_16SC2);
-		if (cameras.GetSize() == 1) {
-			map_1_1f = map_0_1f;
-			map_1_2f = map_0_2f;
-			map_1_1s = map_0_1s;
-			map_1_2s = map_0_2s;
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			rotateOnTheFly = static_cast<bool>(val);
+			std::cout << "Rotation on the fly: " << rotateOnTheFly << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> previewWidth;
+			std::cout << "Preview width: " << previewWidth << std::endl;
 		}
-	}
 
-	if (cameras.GetSize() == 2) {
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> storageFormat;
+			std::cout << "Storage format: " << storageFormat << std::endl;
+		}
 
-		String_t sn2 { };
-		sn2 = cameras[sortedCameraIdx[1]].GetDeviceInfo().GetSerialNumber();
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> segmentSizeMB;
+			std::cout << "Segment size (MB): " << segmentSizeMB << std::endl;
+		}
 
-		std::stringstream ss3 { };
-		ss3 << path_cal;
-		ss3 << "calibration_";
-		ss3 << sn2.c_str();
-		ss3 << "/map1.xml";
-		std::string filename3 = ss3.str();
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			rawCompression = static_cast<bool>(val);
+			std::cout << "Raw compression: " << rawCompression << std::endl;
+		}
 
-		cv::FileStorage file_1_1(filename3, cv::FileStorage::READ);
-		if (file_1_1.isOpened()) {
-			file_1_1["mat_map1"] >> map_1_1f;
-			file_1_1.release();
-			std::cout << "Read " << filename3 << std::endl;
-		} else {
-			throw std::runtime_error("Could not load map_1_1.");
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> compressionThreads;
+			std::cout << "Compression threads: " << compressionThreads << std::endl;
 		}
 
-		std::stringstream ss4 { };
-		ss4 << path_cal;
-		ss4 << "calibration_";
-		ss4 << sn2.c_str();
-		ss4 << "/map2.xml";
-		std::string filename4 = ss4.str();
-
-		cv::FileStorage file_1_2(filename4, cv::FileStorage::READ);
-		if (file_1_2.isOpened()) {
-			file_1_2["mat_map2"] >> map_1_2f;
-			file_1_2.release();
-			std::cout << "Read " << filename4 << std::endl;
-		} else {
-			throw std::runtime_error("Could not load map_0_2.");
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> storageThreads;
+			std::cout << "Storage threads: " << storageThreads << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			asyncWrites = static_cast<bool>(val);
+			std::cout << "Asynchronous writes: " << asyncWrites << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> writesInFlight;
+			std::cout << "Writes in flight: " << writesInFlight << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			val = 0;
+			ss >> val;
+			storeEquirect = static_cast<bool>(val);
+			std::cout << "Store equirectangular: " << storeEquirect << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> imageEncoding.format;
+			std::cout << "Image format: " << imageEncoding.format << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> imageEncoding.jpegQuality;
+			std::cout << "JPEG quality: " << imageEncoding.jpegQuality << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> imageEncoding.pngCompression;
+			std::cout << "PNG compression: " << imageEncoding.pngCompression << std::endl;
+		}
+
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> imageEncoding.webpQuality;
+			std::cout << "WebP quality: " << imageEncoding.webpQuality << std::endl;
 		}
 
-		cv::convertMaps(map_1_1f, map_1_2f, map_1_1s, map_1_2s, CV_16SC2);
+		if (getline(myFile, line)) {
+			token = line.substr(line.find_last_of(":") + 1);
+			ss.str(std::string());
+			ss.clear();
+			ss << token;
+			ss >> imageEncoding.chromaSubsampling;
+			std::cout << "Chroma subsampling: " << imageEncoding.chromaSubsampling << std::endl;
+		}
+
+		myFile.close();
+
+	} else {
+		throw std::runtime_error("Could not open the file to load camera data");
 	}
 
 }
 
-size_t Cameras::GetNumCam() const {
-	return cameras.GetSize();
+void Cameras::LoadMap() {
+// Loads the maps of the calibration.
+// The simulated and replayed cameras may have no calibration, then the images are not remapped.
+	try {
+		LoadMapFiles();
+	} catch (const std::runtime_error &e) {
+		if (sourceType == "pylon") {
+			throw;
+		}
+		std::cerr << e.what() << " The images of the " << sourceType << " source are not remapped." << std::endl;
+		IdentityMaps();
+	}
+
+	// The tiles of the maps are prepared once, the display reuses them for every pair
+	remapEngine.reset(new RemapEngine { remapThreads });
+	remapEngine->setMaps(0, map_0_1s, map_0_2s);
+	if (!map_1_1s.empty()) {
+		remapEngine->setMaps(1, map_1_1s, map_1_2s);
+	}
+	if (previewWidth > 0) {
+		LoadPreviewMaps();
+	}
+	std::cout << "Remap threads: " << remapEngine->getNumThreads() << std::endl;
+
+	if (storeEquirect) {
+		// The storage threads share its pool, each conversion spreads its tiles over it
+		storageRemapEngine.reset(new RemapEngine { remapThreads });
+		storageRemapEngine->setMaps(0, map_0_1s, map_0_2s);
+		if (!map_1_1s.empty()) {
+			storageRemapEngine->setMaps(1, map_1_1s, map_1_2s);
+		}
+	}
 }
 
-inline std::string Cameras::StampTime() {
-	timeval curTime{};
-	gettimeofday(&curTime, nullptr);
-	long int milli { curTime.tv_usec / 1000 };
-	long int micro { curTime.tv_usec % 1000 };
+void Cameras::LoadPreviewMaps() {
+// Small maps of the display, derived from the full ones and stored in the engine after the maps of the cameras
+	const int w = static_cast<int>(std::min<size_t>(previewWidth, map_0_1f.cols));
+
+	cv::Mat p1f { };
+	cv::Mat p2f { };
+	cv::Mat p1s { };
+	cv::Mat p2s { };
+	superpixelMaps(map_0_1f, map_0_2f, w, p1f, p2f);
+	cv::convertMaps(p1f, p2f, p1s, p2s, CV_16SC2);
+	remapEngine->setMaps(previewMap, p1s, p2s);
+
+	superpixelMaps(map_1_1f, map_1_2f, w, preview_1_1f, preview_1_2f);
+	cv::convertMaps(preview_1_1f, preview_1_2f, p1s, p2s, CV_16SC2);
+	remapEngine->setMaps(previewMap + 1, p1s, p2s);
+	std::cout << "Preview size: " << p1s.cols << " x " << p1s.rows << std::endl;
+}
 
-	char buffer [80] {};
-	strftime(buffer, 80, "%Y-%m-%d %H:%M:%S", localtime(&curTime.tv_sec));
+void Cameras::LoadMapFiles() {
+// Reads the maps of the calibration of each camera from path_cal
+// The maps are mapped from the binary cache of each calibration directory, the XML files are parsed only when they changed (see MapCache)
 
-	char currentTime[84] = "";
-	sprintf(currentTime, "%s:%d:%d", buffer, static_cast<int> (milli), static_cast<int> (micro));
-	std::string myTime {currentTime};
-	return myTime;
-}
+	mapStorage.clear();
 
-Cameras::~Cameras() {
+	if (source->GetNumCam() >= 1) {
+		std::string sn1 = source->GetSerialNumber(0);
 
-	cameras.StopGrabbing();
+		MapCache cache { path_cal + "calibration_" + sn1 + "/", sn1 };
+		CalibrationMaps maps = cache.Load();
+		map_0_1f = maps.map1f;
+		map_0_2f = maps.map2f;
+		map_0_1s = maps.map1s;
+		map_0_2s = maps.map2s;
+		mapStorage.push_back(maps.storage);
 
+		if (source->GetNumCam() == 1) {
+			map_1_1f = map_0_1f;
+			map_1_2f = map_0_2f;
+			map_1_1s = map_0_1s;
+			map_1_2s = map_0_2s;
+		}
+	}
+
+	if (source->GetNumCam() == 2) {
+		std::string sn2 = source->GetSerialNumber(1);
+
+		MapCache cache { path_cal + "calibration_" + sn2 + "/", sn2 };
+		CalibrationMaps maps = cache.Load();
+		map_1_1f = maps.map1f;
+		map_1_2f = maps.map2f;
+		map_1_1s = maps.map1s;
+		map_1_2s = maps.map2s;
+		mapStorage.push_back(maps.storage);
+	}
+
+}
 
-	for (size_t i = 0; i < cameras.GetSize(); ++i) {
-		cameras[i].DeviceReset();
+void Cameras::IdentityMaps() {
+// Maps that leave the images as they are
+	map_0_1f.create(static_cast<int>(height), static_cast<int>(width), CV_32FC1);
+	map_0_2f.create(static_cast<int>(height), static_cast<int>(width), CV_32FC1);
+	for (int y = 0; y < map_0_1f.rows; ++y) {
+		for (int x = 0; x < map_0_1f.cols; ++x) {
+			map_0_1f.at<float>(y, x) = static_cast<float>(x);
+			map_0_2f.at<float>(y, x) = static_cast<float>(y);
+		}
 	}
+	cv::convertMaps(map_0_1f, map_0_2f, map_0_1s, map_0_2s, CV_16SC2);
+	map_1_1f = map_0_1f;
+	map_1_2f = map_0_2f;
+	map_1_1s = map_0_1s;
+	map_1_2s = map_0_2s;
+}
 
+size_t Cameras::GetNumCam() const {
+	return source->GetNumCam();
+}
 
-	// Close all cameras.
-	cameras.Close();
+inline int64_t Cameras::StampTime() {
+// Nanoseconds since the epoch, it is converted to the local time only when the image is saved
+	return hostTimeNow();
+}
+
+Cameras::~Cameras() {
+	// The source stops the acquisition and closes the cameras when it is destroyed
 }
 
 } /* namespace ScanVan */
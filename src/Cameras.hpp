@@ -12,17 +12,14 @@
 #ifndef CAMERAS_HPP_
 #define CAMERAS_HPP_
 
-// Include files to use the PYLON API.
-#include <pylon/PylonIncludes.h>
-#include <pylon/gige/PylonGigEIncludes.h>
-#include <pylon/gige/ActionTriggerConfiguration.h>
-
 // Include files to use OpenCV API
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
 #include "Queue.hpp"
+#include "RingBuffer.hpp"
+#include "Mailbox.hpp"
 
 #include <algorithm>
 
@@ -32,6 +29,13 @@
 #include <chrono>
 #include "ImagesRaw.hpp"
 #include "PairImages.hpp"
+#include "FramePool.hpp"
+#include "CameraSource.hpp"
+#include "RemapEngine.hpp"
+#include "MapCache.hpp"
+#include "PinholeRenderer.hpp"
+#include "ThreadPool.hpp"
+#include "AsyncWriter.hpp"
 
 namespace ScanVan {
 
@@ -52,8 +56,7 @@ class Cameras {
 private:
 	// for measuring the time for each part
 	long int number_disp { 0 };
-	long int number_conversions_raw2cv { 0 };
-	long int number_conversions_cv2equi { 0 };
+	long int number_conversions_raw2equi { 0 };
 
 	long int number_grab { 0 };
 	long int number_grab_int { 0 };
@@ -65,8 +68,7 @@ private:
 
 	// for measuring the time for each part
 	double total_duration_disp { 0 };
-	std::chrono::duration<double> total_duration_raw2cv { 0 };
-	std::chrono::duration<double> total_duration_cv2equi { 0 };
+	std::chrono::duration<double> total_duration_raw2equi { 0 };
 
 	double total_duration_grab { 0 };
 	std::chrono::duration<double> total_duration_grab_int { 0 };
@@ -76,21 +78,17 @@ private:
 	std::chrono::duration<double> total_duration_sto_cv { 0 };
 	std::chrono::duration<double> total_duration_sto_equi { 0 };
 
-	Pylon::IGigETransportLayer *pTL{};
-	// Limits the amount of cameras used for grabbing.
-	// It is important to manage the available bandwidth when grabbing with multiple
-	// cameras. This applies, for instance, if two GigE cameras are connected to the
-	// same network adapter via a switch. To manage the bandwidth, the GevSCPD
-	// interpacket delay parameter and the GevSCFTD transmission delay parameter can
-	// be set for each GigE camera device. The "Controlling Packet Transmission Timing
-	// with the Interpacket and Frame Transmission Delays on Basler GigE Vision Cameras"
-	// Application Note (AW000649xx000) provides more information about this topic.
-	uint32_t c_maxCamerasToUse = 2;
-	Pylon::CBaslerGigEInstantCameraArray cameras{};
-	uint32_t DeviceKey = 0;
-	// For this sample we configure all cameras to be in the same group.
-    uint32_t GroupKey = 0x112233;
-    Pylon::String_t subnet {};
+	std::string sourceType { "pylon" }; // Source of the images: "pylon", "simulated" or "replay"
+	std::string replay_path { "./data/" }; // Directory of the sequence played back by the replay source
+
+	size_t remapThreads { 0 }; // Threads of the remap engine, 0 for one per core
+	Interpolation displayInterpolation { Interpolation::LINEAR }; // Interpolation of the equirectangular images displayed
+	bool rotateOnTheFly { false }; // When true the roll calibration is applied by the remap engine instead of rebuilding the map
+	size_t previewWidth { 0 }; // Width of each equirectangular image displayed, 0 displays them at full resolution
+	static const size_t previewMap = 2; // index in the remap engine of the preview map of the camera 0, the camera 1 follows
+	std::unique_ptr<RemapEngine> remapEngine { };
+	PinholeRenderer pinholeRenderer { }; // pinhole views of the display, with their maps cached
+	std::unique_ptr<ICameraSource> source { }; // Declared before the queues, so that it outlives the images that use its buffers
 
     double exposureTime = 13057;// exposure time
     int64_t gain = 23;		// gain
@@ -121,8 +119,6 @@ private:
 	bool autoExpTimeCont = true;
 	bool autoGainCont = true;
 
-	std::vector<size_t> sortedCameraIdx {};
-
 	std::string config_path = {"./config/"}; // default location of the configuration files of the cameras
 	bool loadParam = true; // when true, it will load the configuration files to the cameras
 
@@ -148,32 +144,59 @@ private:
 	cv::Mat map_1_1s;
 	cv::Mat map_1_2s;
 
-	thread_safe_queue<PairImages> imgStorageQueue {}; // The queue where the pair of images are stored for storage.
-	thread_safe_queue<PairImages> imgDisplayQueue {}; // The queue where the pair of images are stored for display.
-	thread_safe_queue<std::string> triggerQueue {}; // The queue where the time stamps are stored and signals the grabbing procedure
+	// Float maps of the camera 1 for the display, see superpixelMaps
+	cv::Mat preview_1_1f;
+	cv::Mat preview_1_2f;
+
+	// Mapped map caches the matrices above may point into
+	std::vector<std::shared_ptr<void>> mapStorage { };
+
+	// Capacities of the queues between the threads. Each slot of the image queues holds a pair of images (2 x 9 MB)
+	// When the storage falls behind, the grab waits. The display only keeps the latest pair.
+	size_t storageQueueCapacity { 32 };
+	size_t triggerQueueCapacity { 16 };
+
+	spsc_ring_buffer<PairImages> imgStorageQueue { storageQueueCapacity, OverflowPolicy::BLOCK }; // The queue where the pair of images are stored for storage.
+	spsc_mailbox<PairImages> imgDisplayQueue { }; // The latest pair for display, the pairs the display could not keep up with are skipped.
+	spsc_ring_buffer<int64_t> triggerQueue { triggerQueueCapacity, OverflowPolicy::BLOCK }; // The queue where the time stamps are stored and signals the grabbing procedure
+
+	// Preallocated buffers for the grabbed images, 0 to take RequiredFrameBuffers() (set by Init)
+	size_t framePoolSize { 0 };
+	std::shared_ptr<FramePool> framePool { };
 
 	long int imgNum { 0 }; // Counts the number of images grabbed from the camera
 
 	std::atomic<bool> exitProgram { false } ;
 
 	void Init();
+	CameraSettings GetSettings() const;
+	size_t RequiredFrameBuffers() const;
+	void IdentityMaps();
 
 	double fps = 4.0; // Desired frame rate
-	bool startSaving { false }; // Flag used to start saving the images into the disk
+	std::atomic<bool> startSaving { false }; // Flag used to start saving the images into the disk, set by the display and read by the grab
 
 	bool useExternalTrigger { false }; // If true it configures the program to use the external trigger in line 1
 
 	bool useChunkFeatures { true }; // If true it uses the camera's clock to get the timestamp
 
-	// White balance settings from cameras
-	// They are read at initialization
-	double balanceR_0 {};
-	double balanceG_0 {};
-	double balanceB_0 {};
-
-	double balanceR_1 { };
-	double balanceG_1 { };
-	double balanceB_1 { };
+	bool storeBatch { false }; // If true the storage takes all the pairs waiting in the queue and saves them in one pass
+	size_t storeBatchSize { 16 }; // Maximum number of pairs saved in one pass
+	std::string storageFormat { "files" }; // "files": two files per image, "sequence": the pairs are appended to large segment files
+	uint64_t segmentSizeMB { 4096 }; // Size of the segment files of the sequences
+	std::unique_ptr<SequenceWriter> sequenceWriter { };
+	bool rawCompression { false }; // If true the raw images are stored losslessly compressed (.rawc, see BayerCodec)
+	size_t compressionThreads { 0 }; // Threads of the compression, 0 for one per core
+	std::unique_ptr<BayerCodec> rawCodec { };
+	size_t storageThreads { 1 }; // Threads that encode and write the pairs of a batch concurrently, 0 for one per core
+	std::unique_ptr<ThreadPool> storagePool { };
+	bool asyncWrites { false }; // If true the files are written in the background with O_DIRECT (see AsyncWriter)
+	size_t writesInFlight { 16 }; // Files being written at the same time, each one holds its image out of the frame pool
+	std::unique_ptr<AsyncWriter> asyncWriter { };
+	bool storeEquirect { false }; // If true the storage converts the raw pairs to equirectangular images, written with imageEncoding
+	ImageEncoding imageEncoding { }; // Format of the RGB and equirectangular images stored
+	std::unique_ptr<RemapEngine> storageRemapEngine { }; // Tiles of the storage, the rotation calibration changes the ones of the display
+	bool zeroCopyGrab { false }; // If true the images keep the Pylon grab buffers instead of copying them into the frame pool
 
 	//Rotation calibration stuff
 	float rotCalibAlpha = 0;
@@ -223,6 +246,26 @@ public:
 		return imgDisplayQueue.empty();
 	}
 
+	size_t getStorageQueueDropped() const {
+		return imgStorageQueue.getDropped();
+	}
+
+	size_t getDisplayQueueDropped() const {
+		return imgDisplayQueue.getDropped();
+	}
+
+	size_t getTriggerQueueDropped() const {
+		return triggerQueue.getDropped();
+	}
+
+	size_t getFramePoolExhausted() const {
+		return framePool->getExhaustedCount();
+	}
+
+	size_t getFramePoolMinAvailable() const {
+		return framePool->getMinAvailable();
+	}
+
 	long int getImgNum () const { return imgNum; };
 
 	bool getExitStatus () const {
@@ -230,15 +273,28 @@ public:
 	}
 
 	void IssueActionCommand();
-	void GrabImages();
-	void StoreImages();
-	void DisplayImages();
+	bool GrabImages();
+	long int StoreImages();
+	long int StoreImagesBatch();
+	StorageOptions GetStorageOptions() const;
+	bool DisplayImages();
+
+	// Shutdown of the pipeline: each stage closes the queue of the next stage when it finishes,
+	// the next stage then empties its queue and finishes too.
+	void CloseTriggerQueue() { triggerQueue.close(); };
+	void CloseDisplayQueue() { imgDisplayQueue.close(); };
+	void CloseStorageQueue() { imgStorageQueue.close(); };
+	bool GrabFinished();
+	bool DisplayFinished();
+	bool StorageFinished();
+	void CloseStorage();
 	void SaveParameters();
-	void LoadParameters();
 	void LoadCameraConfig();
 	void LoadMap();
+	void LoadMapFiles();
+	void LoadPreviewMaps();
 	void DemoLoadImages();
-	std::string StampTime();
+	int64_t StampTime();
 
 	void inc_disp_counter() {
 		number_disp++;
@@ -246,6 +302,9 @@ public:
 	void inc_sto_counter() {
 		number_sto++;
 	}
+	void inc_sto_counter(long int n) {
+		number_sto += n;
+	}
 	void inc_grab_counter() {
 		number_grab++;
 	}
@@ -276,11 +335,8 @@ public:
 			return total_duration_grab_int.count() / number_grab_int * 1000.0;
 	}
 
-	double get_avg_raw2cv() {
-		return total_duration_raw2cv.count() / number_conversions_raw2cv * 1000.0;
-	}
-	double get_avg_cv2equi() {
-		return total_duration_cv2equi.count() / number_conversions_cv2equi * 1000.0;
+	double get_avg_raw2equi() {
+		return total_duration_raw2equi.count() / number_conversions_raw2equi * 1000.0;
 	}
 	double get_avg_sto_raw() {
 		return total_duration_sto_raw.count() / number_sto_raw * 1000.0;
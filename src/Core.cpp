@@ -14,27 +14,32 @@
 #include <unistd.h>
 #include <chrono>
 #include <thread>
+#include <array>
 
 // Include files to use OpenCV API
 #include <opencv2/opencv.hpp>
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 
+#ifdef USE_GIGE
 // Include files to use the PYLON API.
 #include <pylon/PylonIncludes.h>
 #include <pylon/gige/PylonGigEIncludes.h>
 #include <pylon/gige/ActionTriggerConfiguration.h>
+#endif
 #include "Cameras.hpp"
 
 #include <time.h>
 #include <chrono>
 #include "ImagesRaw.hpp"
 
+#ifdef USE_GIGE
 // Settings to use Basler GigE cameras.
 using namespace Basler_GigECameraParams;
 
 // Namespace for using pylon objects.
 using namespace Pylon;
+#endif
 
 // Namespace for using cout.
 using namespace std;
@@ -83,6 +88,9 @@ void IssueTrigger (ScanVan::Cameras *cams) {
 		++counter;
 	}
 
+	// No more triggers, the grabbing finishes once the pending ones are processed
+	cams->CloseTriggerQueue();
+
 	t2 = std::chrono::high_resolution_clock::now();
 
 	// Measure duration of grabbing
@@ -102,12 +110,14 @@ void GrabImages(ScanVan::Cameras *cams) {
 	// Measure the starting of grabbing
 	t1 = std::chrono::high_resolution_clock::now();
 
-	while (cams->getExitStatus() == false) {
+	while (cams->GrabFinished() == false) {
 
 		t1_i = std::chrono::high_resolution_clock::now();
 
 		// Grab images
-		cams->GrabImages();
+		if (cams->GrabImages() == false) {
+			continue;
+		}
 
 		t2_i = std::chrono::high_resolution_clock::now();
 
@@ -121,6 +131,10 @@ void GrabImages(ScanVan::Cameras *cams) {
 
 	}
 
+	// The display and the storage finish once they have processed the pairs already grabbed
+	cams->CloseDisplayQueue();
+	cams->CloseStorageQueue();
+
 	// Measure the end of the grabbing
 	t2 = std::chrono::high_resolution_clock::now();
 
@@ -140,14 +154,11 @@ void StoreImages(ScanVan::Cameras *cams) {
 	t1 = std::chrono::high_resolution_clock::now();
 
 
-	while (cams->getExitStatus() == false) {
-		cams->StoreImages();
-		cams->inc_sto_counter();
-	}
-	while (cams->imgStorageQueueEmpty() == false) {
-		cams->StoreImages();
-		cams->inc_sto_counter();
+	// Runs until the storage queue is closed and all the pairs in it are saved
+	while (cams->StorageFinished() == false) {
+		cams->inc_sto_counter(cams->StoreImages());
 	}
+	cams->CloseStorage();
 
 	t2 = std::chrono::high_resolution_clock::now();
 
@@ -166,17 +177,13 @@ void DisplayImages(ScanVan::Cameras *cams) {
 	// Measure the starting of displaying
 	t1 = std::chrono::high_resolution_clock::now();
 
-	while (cams->getExitStatus() == false) {
-
-		cams->DisplayImages();
-
-		cams->inc_disp_counter();
+	// Runs until the display queue is closed and all the pairs in it are processed
+	while (cams->DisplayFinished() == false) {
 
-	}
-	while (cams->imgDisplayQueueEmpty() == false) {
-		cams->DisplayImages();
+		if (cams->DisplayImages()) {
+			cams->inc_disp_counter();
+		}
 
-		cams->inc_disp_counter();
 	}
 
 	t2 = std::chrono::high_resolution_clock::now();
@@ -203,7 +210,9 @@ int main(int argc, char* argv[])
 
     int exitCode { 0 };
 
+#ifdef USE_GIGE
     PylonAutoInitTerm autoinitTerm{};
+#endif
 
     std::string curr_path = GetCurrentWorkingDir();
     std::string config_path = curr_path + "/" + "config/";
@@ -243,18 +252,24 @@ int main(int argc, char* argv[])
 		cout << "===>Time lapse grab images internal: " <<  cams.get_avg_grab_int() << " ms" << endl;
 
 		cout << "===>Time lapse display images: " << cams.get_avg_disp() << " ms" << endl;
-		cout << "===>Time lapse raw to cv : " << cams.get_avg_raw2cv() << " ms" << endl;
-		cout << "===>Time lapse cv to equi: " << cams.get_avg_cv2equi() << " ms" << endl;
+		cout << "===>Time lapse raw to equi: " << cams.get_avg_raw2equi() << " ms" << endl;
 
 		cout << "===>Time lapse store images: " << cams.get_avg_sto() << " ms" << endl;
 		cout << "===>Time lapse sto raw: " <<  cams.get_avg_sto_raw() << " ms" << endl;
 		cout << "===>Time lapse sto cv: " <<  cams.get_avg_sto_cv() << " ms" << endl;
 		cout << "===>Time lapse sto equi: " <<  cams.get_avg_sto_equi() << " ms" << endl;
 
+		cout << "===>Triggers dropped: " << cams.getTriggerQueueDropped() << endl;
+		cout << "===>Frames skipped by the display: " << cams.getDisplayQueueDropped() << endl;
+		cout << "===>Frames dropped for storage: " << cams.getStorageQueueDropped() << endl;
+		cout << "===>Frame pool exhausted: " << cams.getFramePoolExhausted() << " times, minimum free buffers: " << cams.getFramePoolMinAvailable() << endl;
+
+#ifdef USE_GIGE
 	} catch (const GenericException &e) {
 		// Error handling
 		cerr << "An exception occurred." << endl << e.GetDescription() << endl;
 		exitCode = 1;
+#endif
 	} catch (const std::exception &e) {
 		cerr << "An exception ocurred." << endl << e.what() << endl;
 		exitCode = 1;
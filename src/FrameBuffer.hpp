@@ -0,0 +1,53 @@
+//============================================================================
+// Name        : FrameBuffer.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Storage of the pixels of a raw image. The ImagesRaw objects
+//				 hold their pixels through this interface, so the memory can
+//				 come from the heap or from a preallocated pool.
+//============================================================================
+
+#ifndef FRAMEBUFFER_HPP_
+#define FRAMEBUFFER_HPP_
+
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include <cstring>
+
+namespace ScanVan {
+
+class FrameBuffer {
+public:
+	virtual uint8_t * data() = 0;
+	virtual const uint8_t * data() const = 0;
+	virtual size_t size() const = 0;	// number of bytes of the image
+
+	// Returns a new buffer with a copy of the pixels
+	virtual std::shared_ptr<FrameBuffer> clone() const = 0;
+
+	virtual ~FrameBuffer() {};
+};
+
+class HeapFrameBuffer: public FrameBuffer {
+private:
+	std::vector<uint8_t> buf;
+public:
+	HeapFrameBuffer(size_t n) : buf(n) {};
+	HeapFrameBuffer(const uint8_t *p, size_t n) : buf(p, p + n) {};
+
+	uint8_t * data() { return buf.data(); };
+	const uint8_t * data() const { return buf.data(); };
+	size_t size() const { return buf.size(); };
+
+	std::shared_ptr<FrameBuffer> clone() const {
+		return std::make_shared<HeapFrameBuffer>(buf.data(), buf.size());
+	};
+
+	virtual ~HeapFrameBuffer() {};
+};
+
+} /* namespace ScanVan */
+
+#endif /* FRAMEBUFFER_HPP_ */
@@ -0,0 +1,65 @@
+//============================================================================
+// Name        : FrameMetadata.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Conversions of the time stamps of the camera data to text.
+//============================================================================
+
+#include "FrameMetadata.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+namespace ScanVan {
+
+int64_t hostTimeNow() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static void splitHostTime(int64_t ns, struct tm &st, int &milli, int &micro) {
+// Splits the time into the local calendar time and the milliseconds and microseconds of the second
+	time_t sec = static_cast<time_t>(ns / 1000000000);
+	long int usec = static_cast<long int>((ns % 1000000000) / 1000);
+	localtime_r(&sec, &st);
+	milli = static_cast<int>(usec / 1000);
+	micro = static_cast<int>(usec % 1000);
+}
+
+std::string formatHostTime(int64_t ns) {
+	struct tm st { };
+	int milli { }, micro { };
+	splitHostTime(ns, st, milli, micro);
+
+	char buffer[80] { };
+	size_t n = strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &st);
+	snprintf(buffer + n, sizeof(buffer) - n, ":%d:%d", milli, micro);
+	return std::string { buffer };
+}
+
+int64_t parseHostTime(const std::string &str) {
+	struct tm st { };
+	int milli { }, micro { };
+	if (sscanf(str.c_str(), " %d-%d-%d %d:%d:%d:%d:%d", &st.tm_year, &st.tm_mon, &st.tm_mday, &st.tm_hour, &st.tm_min, &st.tm_sec, &milli, &micro) != 8) {
+		return 0;
+	}
+	st.tm_year -= 1900;
+	st.tm_mon -= 1;
+	st.tm_isdst = -1;
+	time_t sec = mktime(&st);
+	return static_cast<int64_t>(sec) * 1000000000 + (static_cast<int64_t>(milli) * 1000 + micro) * 1000;
+}
+
+std::string formatHostTimeFileName(int64_t ns) {
+	struct tm st { };
+	int milli { }, micro { };
+	splitHostTime(ns, st, milli, micro);
+
+	char buffer[80] { };
+	size_t n = strftime(buffer, sizeof(buffer), "%Y%m%d-%H%M%S", &st);
+	snprintf(buffer + n, sizeof(buffer) - n, "-%03d%03d", milli, micro);
+	return std::string { buffer };
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,51 @@
+//============================================================================
+// Name        : FrameMetadata.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Camera data attached to every image. It holds only numbers,
+//				 so it is copied as one block and filled on the trigger and
+//				 grab threads without allocating or formatting. The times are
+//				 converted to text only when they are written out.
+//============================================================================
+
+#ifndef FRAMEMETADATA_HPP_
+#define FRAMEMETADATA_HPP_
+
+#include <string>
+#include <type_traits>
+#include <stdint.h>
+
+namespace ScanVan {
+
+struct FrameMetadata {
+	int64_t captureTimeCPU = 0;	// capture time taken on the CPU, nanoseconds since the epoch
+	int64_t captureTimeCam = 0;	// trigger time retrieved from the camera, number of ticks
+	int64_t frameId = 0;		// image number
+	int64_t gain = 0;			// gain
+	double exposureTime = 0;	// exposure time
+	double balanceR = 0;		// white balance R
+	double balanceG = 0;		// white balance G
+	double balanceB = 0;		// white balance B
+	uint32_t cameraIdx = 0;		// camera index
+	int32_t autoExpTime = 0;	// Auto Exposure Time
+	int32_t autoGain = 0; 		// Auto Gain
+};
+
+static_assert(std::is_trivially_copyable<FrameMetadata>::value, "FrameMetadata must stay a plain block of numbers");
+
+// Current time of the CPU clock in nanoseconds since the epoch
+int64_t hostTimeNow();
+
+// Local time as written in the camera data files, e.g. 2019-03-18 18:25:07:123:456
+std::string formatHostTime(int64_t ns);
+
+// Inverse of formatHostTime, returns 0 if the string cannot be read
+int64_t parseHostTime(const std::string &str);
+
+// Local time for file names, e.g. 20190318-182507-123456
+std::string formatHostTimeFileName(int64_t ns);
+
+} /* namespace ScanVan */
+
+#endif /* FRAMEMETADATA_HPP_ */
@@ -0,0 +1,98 @@
+//============================================================================
+// Name        : FramePool.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Pool of preallocated, page-aligned buffers for the raw images.
+//============================================================================
+
+#include "FramePool.hpp"
+
+#include <iostream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ScanVan {
+
+FramePool::FramePool(size_t frameSize, size_t numSlabs) : frameSize { frameSize }, numSlabs { numSlabs } {
+// Maps the memory for all the buffers at once.
+// MAP_POPULATE makes the kernel provide the pages now instead of at the first write.
+
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	slabSize = (frameSize + pageSize - 1) / pageSize * pageSize;
+	memorySize = slabSize * numSlabs;
+
+	if (memorySize > 0) {
+		void *p = mmap(nullptr, memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+		if (p == MAP_FAILED) {
+			throw std::runtime_error("Could not allocate the memory for the frame pool.");
+		}
+		p_memory = static_cast<uint8_t *>(p);
+	}
+
+	freeSlabs.reserve(numSlabs);
+	for (size_t i = 0; i < numSlabs; ++i) {
+		freeSlabs.push_back(p_memory + i * slabSize);
+	}
+	minAvailable = numSlabs;
+}
+
+std::shared_ptr<FramePool> FramePool::create(size_t frameSize, size_t numSlabs) {
+	return std::shared_ptr<FramePool>(new FramePool { frameSize, numSlabs });
+}
+
+std::shared_ptr<FrameBuffer> FramePool::acquire() {
+	uint8_t *p { nullptr };
+	{
+		std::lock_guard<std::mutex> lg { m };
+		if (!freeSlabs.empty()) {
+			p = freeSlabs.back();
+			freeSlabs.pop_back();
+			if (freeSlabs.size() < minAvailable) {
+				minAvailable = freeSlabs.size();
+			}
+		}
+	}
+
+	if (p == nullptr) {
+		// Report the first time and then every 100 times, the caller decides what to do
+		if ((exhaustedCount++ % 100) == 0) {
+			std::cerr << "Frame pool exhausted (" << numSlabs << " buffers in use), " << exhaustedCount << " time(s) so far." << std::endl;
+		}
+		return std::shared_ptr<FrameBuffer>();
+	}
+
+	return std::make_shared<PooledFrameBuffer>(shared_from_this(), p);
+}
+
+void FramePool::release(uint8_t *p) {
+	std::lock_guard<std::mutex> lg { m };
+	freeSlabs.push_back(p);
+}
+
+size_t FramePool::getAvailable() {
+	std::lock_guard<std::mutex> lg { m };
+	return freeSlabs.size();
+}
+
+FramePool::~FramePool() {
+	if (p_memory != nullptr) {
+		munmap(p_memory, memorySize);
+	}
+}
+
+std::shared_ptr<FrameBuffer> PooledFrameBuffer::clone() const {
+	std::shared_ptr<FrameBuffer> b = pool->acquire();
+	if (!b) {
+		b = std::make_shared<HeapFrameBuffer>(pool->frameSize);
+	}
+	memcpy(b->data(), p, pool->frameSize);
+	return b;
+}
+
+PooledFrameBuffer::~PooledFrameBuffer() {
+	pool->release(p);
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,86 @@
+//============================================================================
+// Name        : FramePool.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Pool of preallocated, page-aligned buffers for the raw images.
+//				 The memory is mapped and touched once at start, so grabbing an
+//				 image costs neither an allocation nor page faults. A buffer
+//				 borrowed from the pool returns to it when the last image that
+//				 uses it is destroyed.
+//============================================================================
+
+#ifndef FRAMEPOOL_HPP_
+#define FRAMEPOOL_HPP_
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <stdint.h>
+
+#include "FrameBuffer.hpp"
+
+namespace ScanVan {
+
+class FramePool: public std::enable_shared_from_this<FramePool> {
+private:
+	size_t frameSize;		// number of bytes of one image
+	size_t slabSize;		// frameSize rounded up to the page size
+	size_t numSlabs;
+	uint8_t *p_memory { nullptr };
+	size_t memorySize { 0 };
+
+	std::mutex m;
+	std::vector<uint8_t *> freeSlabs { };
+
+	std::atomic<size_t> exhaustedCount { 0 };	// number of times a buffer was requested and none was available
+	std::atomic<size_t> minAvailable { 0 };	// lowest number of free buffers seen
+
+	FramePool(size_t frameSize, size_t numSlabs);
+
+	void release(uint8_t *p);
+
+	friend class PooledFrameBuffer;
+
+public:
+	// The pool is always owned by a shared pointer, so that the buffers can outlive their owner
+	static std::shared_ptr<FramePool> create(size_t frameSize, size_t numSlabs);
+
+	FramePool(const FramePool &) = delete;
+	FramePool & operator=(const FramePool &) = delete;
+
+	// Returns an empty pointer if there is no buffer available
+	std::shared_ptr<FrameBuffer> acquire();
+
+	size_t getFrameSize() const { return frameSize; };
+	size_t getNumSlabs() const { return numSlabs; };
+	size_t getAvailable();
+	size_t getMinAvailable() const { return minAvailable; };
+	size_t getExhaustedCount() const { return exhaustedCount; };
+
+	virtual ~FramePool();
+};
+
+class PooledFrameBuffer: public FrameBuffer {
+private:
+	std::shared_ptr<FramePool> pool;
+	uint8_t *p;
+public:
+	PooledFrameBuffer(std::shared_ptr<FramePool> pool, uint8_t *p) : pool { std::move(pool) }, p { p } {};
+	PooledFrameBuffer(const PooledFrameBuffer &) = delete;
+	PooledFrameBuffer & operator=(const PooledFrameBuffer &) = delete;
+
+	uint8_t * data() { return p; };
+	const uint8_t * data() const { return p; };
+	size_t size() const { return pool->frameSize; };
+
+	// The copy is taken from the same pool if possible, otherwise from the heap
+	std::shared_ptr<FrameBuffer> clone() const;
+
+	virtual ~PooledFrameBuffer();
+};
+
+} /* namespace ScanVan */
+
+#endif /* FRAMEPOOL_HPP_ */
@@ -0,0 +1,73 @@
+//============================================================================
+// Name        : ImageEncoding.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : File format of the RGB and equirectangular images.
+//============================================================================
+
+#include "ImageEncoding.hpp"
+
+#include <stdexcept>
+#include <iostream>
+
+#include <opencv2/opencv.hpp>
+
+// The sampling factor of the JPEG chroma can be chosen since OpenCV 4.5.5, before the encoder always subsamples 4:2:0
+#define JPEG_SAMPLING_FACTOR ((CV_VERSION_MAJOR > 4) || ((CV_VERSION_MAJOR == 4) && ((CV_VERSION_MINOR > 5) || ((CV_VERSION_MINOR == 5) && (CV_VERSION_REVISION >= 5)))))
+
+namespace ScanVan {
+
+ImageEncoding ImageEncoding::fromExtension(const std::string &ext) {
+	ImageEncoding e { };
+	e.format = (ext == "jpeg") ? "jpg" : ext;
+	e.validate();
+	return e;
+}
+
+void ImageEncoding::validate() const {
+	if ((format != "bmp") && (format != "jpg") && (format != "png") && (format != "webp")) {
+		throw std::runtime_error("Unknown image format " + format + ", expected bmp, jpg, png or webp.");
+	}
+	if ((jpegQuality < 0) || (jpegQuality > 100)) {
+		throw std::runtime_error("The JPEG quality must be between 0 and 100.");
+	}
+	if ((pngCompression < 0) || (pngCompression > 9)) {
+		throw std::runtime_error("The PNG compression must be between 0 and 9.");
+	}
+	if (webpQuality < 1) {
+		throw std::runtime_error("The WebP quality must be at least 1.");
+	}
+	if ((chromaSubsampling != "444") && (chromaSubsampling != "422") && (chromaSubsampling != "420")) {
+		throw std::runtime_error("Unknown chroma subsampling " + chromaSubsampling + ", expected 444, 422 or 420.");
+	}
+#if !JPEG_SAMPLING_FACTOR
+	if ((format == "jpg") && (chromaSubsampling != "420")) {
+		std::cerr << "This version of OpenCV always subsamples the JPEG chroma 4:2:0." << std::endl;
+	}
+#endif
+}
+
+std::vector<int> ImageEncoding::params() const {
+	std::vector<int> p { };
+	if (format == "jpg") {
+		p = { cv::IMWRITE_JPEG_QUALITY, jpegQuality };
+#if JPEG_SAMPLING_FACTOR
+		int factor = cv::IMWRITE_JPEG_SAMPLING_FACTOR_420;
+		if (chromaSubsampling == "444") {
+			factor = cv::IMWRITE_JPEG_SAMPLING_FACTOR_444;
+		} else if (chromaSubsampling == "422") {
+			factor = cv::IMWRITE_JPEG_SAMPLING_FACTOR_422;
+		}
+		p.push_back(cv::IMWRITE_JPEG_SAMPLING_FACTOR);
+		p.push_back(factor);
+#endif
+	} else if (format == "png") {
+		p = { cv::IMWRITE_PNG_COMPRESSION, pngCompression };
+	} else if (format == "webp") {
+		p = { cv::IMWRITE_WEBP_QUALITY, webpQuality };
+	}
+	return p;
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,42 @@
+//============================================================================
+// Name        : ImageEncoding.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : File format of the RGB and equirectangular images and the
+//				 settings of its encoder. BMP is uncompressed, JPEG and WebP
+//				 are lossy (WebP is lossless above quality 100) and PNG is
+//				 lossless.
+//============================================================================
+
+#ifndef IMAGEENCODING_HPP_
+#define IMAGEENCODING_HPP_
+
+#include <string>
+#include <vector>
+
+namespace ScanVan {
+
+struct ImageEncoding {
+	std::string format { "bmp" };				// "bmp", "jpg", "png" or "webp"
+	int jpegQuality { 95 };						// 0 to 100
+	int pngCompression { 3 };					// 0 to 9, the higher the smaller and the slower
+	int webpQuality { 90 };						// 1 to 100, above 100 the image is lossless
+	std::string chromaSubsampling { "420" };	// JPEG: "444" (none), "422" or "420"
+
+	// Settings of the format given by the extension of a file name ("jpeg" is read as "jpg")
+	static ImageEncoding fromExtension(const std::string &ext);
+
+	// Throws if the format or its settings are not valid
+	void validate() const;
+
+	// Extension of the files, with the dot
+	std::string extension() const { return "." + format; }
+
+	// Parameters of cv::imwrite and cv::imencode
+	std::vector<int> params() const;
+};
+
+} /* namespace ScanVan */
+
+#endif /* IMAGEENCODING_HPP_ */
@@ -1,99 +1,78 @@
 #include "ImagesCV.hpp"
+#include "BayerRemap.hpp"
 
 namespace ScanVan {
 
 ImagesCV::ImagesCV(): Images() {
-	p_openCvImage = new cv::Mat {};
 }
 
-ImagesCV::ImagesCV(ImagesRaw &img): Images{} {
+ImagesCV::ImagesCV(const ImagesRaw &img): Images{} {
 
-	cv::Mat openCvImageRG8 = cv::Mat(height, width, CV_8UC1, img.getBufferP());
+	// The raw pixels are only read, the matrix header points to the shared buffer
+	cv::Mat openCvImageRG8 = cv::Mat(img.getHeight(), img.getWidth(), CV_8UC1, const_cast<uint8_t *>(img.getData()));
 
-	p_openCvImage = new cv::Mat{};
-
-	cv::cvtColor(openCvImageRG8, *p_openCvImage, cv::COLOR_BayerRG2RGB);
+	cv::cvtColor(openCvImageRG8, openCvImage, cv::COLOR_BayerRG2RGB);
 
 	height = img.getHeight();
 	width = img.getWidth();
-	cameraIdx = img.getCameraIdx();	// camera index
-	captureTimeCPUStr = img.getCaptureCPUTime(); // capture time taken on the CPU in string format
-	captureTimeCamStr = img.getCaptureCamTime(); // trigger time retrieved from the camera, number of ticks, string format
-	exposureTime = img.getExposureTime();// exposure time
-	gain = img.getGain();		// gain
-	balanceR = img.getBalanceR();	// white balance R
-	balanceG = img.getBalanceG();	// white balance G
-	balanceB = img.getBalanceB();	// white balance B
-	autoExpTime = img.getAutoExpTime();	// Auto Exposure Time
-	autoGain = img.getAutoGain(); 		// Auto Gain
-	numImages = img.getImgNumber();
+	meta = img.getMetadata();	// camera index, time stamps, exposure, gain, white balance and image number
 	serialNum = img.getSerialNumber();
 }
 
-ImagesCV::ImagesCV(ImagesCV &img): Images{} {
-
-	p_openCvImage = new cv::Mat{*(img.p_openCvImage)};
+ImagesCV::ImagesCV(const ImagesRaw &img, const cv::Mat & map_1, const cv::Mat & map_2): Images{} {
+// Demosaics and remaps the raw image in one pass, see bayerRemap
 
-	//openCvImage = img.openCvImage.clone();
+	bayerRemap(img.getData(), static_cast<int>(img.getHeight()), static_cast<int>(img.getWidth()), map_1, map_2, openCvImage);
 
-	height = img.getHeight();
-	width = img.getWidth();
-	cameraIdx = img.getCameraIdx();	// camera index
-	captureTimeCPUStr = img.getCaptureCPUTime(); // capture time taken on the CPU in string format
-	captureTimeCamStr = img.getCaptureCamTime(); // trigger time retrieved from the camera, number of ticks, string format
-	exposureTime = img.getExposureTime();// exposure time
-	gain = img.getGain();		// gain
-	balanceR = img.getBalanceR();	// white balance R
-	balanceG = img.getBalanceG();	// white balance G
-	balanceB = img.getBalanceB();	// white balance B
-	autoExpTime = img.getAutoExpTime();	// Auto Exposure Time
-	autoGain = img.getAutoGain(); 		// Auto Gain
-	numImages = img.getImgNumber();
+	height = openCvImage.rows;
+	width = openCvImage.cols;
+	meta = img.getMetadata();
 	serialNum = img.getSerialNumber();
 }
 
-ImagesCV::ImagesCV(ImagesCV &&img): Images{} {
-
-	p_openCvImage = img.p_openCvImage;
-	img.p_openCvImage = nullptr;
+ImagesCV::ImagesCV(const ImagesRaw &img, const cv::Mat &m): Images{} {
+// Takes the camera data of the raw image and the pixels of m, e.g. the output of the remap engine
 
-	height = img.getHeight();
-	width = img.getWidth();
-	cameraIdx = img.getCameraIdx();	// camera index
-	captureTimeCPUStr = img.getCaptureCPUTime(); // capture time taken on the CPU in string format
-	captureTimeCamStr = img.getCaptureCamTime(); // trigger time retrieved from the camera, number of ticks, string format
-	exposureTime = img.getExposureTime();// exposure time
-	gain = img.getGain();		// gain
-	balanceR = img.getBalanceR();	// white balance R
-	balanceG = img.getBalanceG();	// white balance G
-	balanceB = img.getBalanceB();	// white balance B
-	autoExpTime = img.getAutoExpTime();	// Auto Exposure Time
-	autoGain = img.getAutoGain(); 		// Auto Gain
-	numImages = img.getImgNumber();
+	openCvImage = m;
+	height = openCvImage.rows;
+	width = openCvImage.cols;
+	meta = img.getMetadata();
 	serialNum = img.getSerialNumber();
 }
 
+void ImagesCV::setMat(const cv::Mat &m) {
+// Replaces the pixels, the copies that share the previous matrix keep it
+	openCvImage = m;
+	height = openCvImage.rows;
+	width = openCvImage.cols;
+}
 
+void ImagesCV::detach() {
+// Copy on write: makes the pixels private to this object if other images share them
+	if ((openCvImage.u != nullptr) && (openCvImage.u->refcount > 1)) {
+		openCvImage = openCvImage.clone();
+	}
+}
 
 void ImagesCV::show () const {
 	/// Display
 	cv::namedWindow("Image", cv::WINDOW_NORMAL);
-	cv::imshow("Image", *p_openCvImage);
+	cv::imshow("Image", openCvImage);
 };
 
 void ImagesCV::show(std::string name) const {
 	/// Display
 	cv::namedWindow(name, cv::WINDOW_NORMAL);
-	cv::imshow(name, *p_openCvImage);
+	cv::imshow(name, openCvImage);
 };
 
-void ImagesCV::showConcat (std::string name, Images &img2) const {
+void ImagesCV::showConcat (std::string name, const ImagesCV &img2) const {
 
 	cv::Mat m;
-	try {
-		cv::hconcat(*p_openCvImage, *(dynamic_cast<ImagesCV &>(img2).p_openCvImage), m);
-	} catch (...) {
-		m = *p_openCvImage;
+	if (img2.getImgBufferSize() != 0) {
+		cv::hconcat(openCvImage, img2.openCvImage, m);
+	} else {
+		m = openCvImage;
 	}
 
 	/// Display
@@ -103,51 +82,59 @@ void ImagesCV::showConcat (std::string name, Images &img2) const {
 
 void ImagesCV::remap (const cv::Mat & map_1, const cv::Mat & map_2) {
 
-	cv::Mat * undistorted = new cv::Mat{};
-	cv::Mat * old_p_img = p_openCvImage;
+	cv::Mat undistorted { };
 
 	// main remapping function that undistort the images
-	cv::remap(*p_openCvImage, *undistorted, map_1, map_2, cv::INTER_CUBIC, cv::BORDER_CONSTANT);
+	// the result goes to a new matrix, the copies that share the original keep it
+	cv::remap(openCvImage, undistorted, map_1, map_2, cv::INTER_CUBIC, cv::BORDER_CONSTANT);
 
-	p_openCvImage = undistorted;
-	delete old_p_img;
+	openCvImage = undistorted;
+}
+
+static void writeImage(const std::string &path, const cv::Mat &m, const ImageEncoding &encoding) {
+	bool ok { false };
+	try {
+		ok = cv::imwrite(path, m, encoding.params());
+	} catch (std::exception & ex) {
+		std::cerr << "Error writing the " << encoding.format << " file: " << ex.what() << std::endl;
+		throw;
+	}
+	if (!ok) {
+		throw std::runtime_error("Could not write the file " + path);
+	}
 }
 
 void ImagesCV::saveImage (std::string path) {
 	// It saves the object's image to file
-	// It saves in bmp format
+	// The format is given by the extension: bmp, jpg, png or webp, with the default settings of ImageEncoding
 	std::string ext = path.substr(path.find_last_of(".") + 1);
 
 	// Save the raw image into file
 	if (ext == "raw") {
 		throw std::runtime_error("Tried to save file in raw format from object ImagesCV");
-	} else if (ext == "bmp") {
-		try {
-			imwrite(path, *p_openCvImage);
-		} catch (std::exception & ex) {
-			std::cerr << "Error writing the bmp file: " << ex.what() << std::endl;
-			throw ex;
-		}
-	} else {
+	}
+	ImageEncoding encoding { };
+	try {
+		encoding = ImageEncoding::fromExtension(ext);
+	} catch (std::runtime_error &) {
 		throw std::runtime_error("File extension not recognized when trying to save the image from ImagesCV.");
 	}
+	writeImage(path, openCvImage, encoding);
 }
 
-void ImagesCV::saveData(std::string path) {
-	// Saves the opencv image and the camera data to file
+void ImagesCV::saveData(std::string path, const ImageEncoding &encoding) {
+	// Saves the opencv image to file
 	// Here path is the path to the directory where the images will be stored.
 	// The image number and the camera index are extracted from the object.
-	// The function will automatically add the .bmp for the opencv data image and .txt for the camera
-	// configuration.
-
+	// The function will automatically add the extension of the encoding, e.g. .bmp
 
 	std::stringstream ss1 { };
 
 	ss1 << path;
-	ss1 << cameraIdx;
+	ss1 << meta.cameraIdx;
 	ss1 << "_";
-	ss1 << numImages;
-	ss1 << ".bmp";
+	ss1 << meta.frameId;
+	ss1 << encoding.extension();
 
 //	std::stringstream ss2 { };
 //
@@ -159,10 +146,7 @@ void ImagesCV::saveData(std::string path) {
 //	ss2 << "_bmp";
 //	ss2 << ".txt";
 
-	std::string path_bmp;
-	ss1 >> path_bmp;
-
-	saveImage(path_bmp);
+	writeImage(ss1.str(), openCvImage, encoding);
 
 //	std::string path_data;
 //	ss2 >> path_data;
@@ -187,74 +171,58 @@ void ImagesCV::saveData(std::string path) {
 //	}
 }
 
-void ImagesCV::saveDataConcat (std::string path, Images &img2) {
+void ImagesCV::saveDataConcat (std::string path, const ImagesCV &img2, const ImageEncoding &encoding) {
 
-	// Saves the opencv image and the camera data to file
+	// Saves the concatenation of both images to file
 	// Here path is the path to the directory where the images will be stored.
-	// The image number and the camera index are extracted from the object.
-	// The function will automatically add the .bmp for the opencv data image and .txt for the camera
-	// configuration.
+	// The function will automatically add the extension of the encoding, e.g. .jpg
 
 	std::stringstream ss1 { };
 
-	std::string year = captureTimeCPUStr.substr(0, captureTimeCPUStr.find_first_of("-"));
-	std::string token = captureTimeCPUStr.substr(captureTimeCPUStr.find_first_of("-")+1, captureTimeCPUStr.length());
-	std::string month = token.substr(0, token.find_first_of("-"));
-	token = token.substr(token.find_first_of("-")+1, token.length());
-	std::string day = token.substr(0, token.find_first_of(" "));
-	token = token.substr(token.find_first_of(" ")+1, token.length());
-	std::string hour = token.substr(0, token.find_first_of(":"));
-	token = token.substr(token.find_first_of(":")+1, token.length());
-	std::string min = token.substr(0, token.find_first_of(":"));
-	token = token.substr(token.find_first_of(":")+1, token.length());
-	std::string sec = token.substr(0, token.find_first_of(":"));
-	token = token.substr(token.find_first_of(":")+1, token.length());
-	std::string milisec = token.substr(0, token.find_first_of(":"));
-	token = token.substr(token.find_first_of(":")+1, token.length());
-	std::string microsec = token;
-
-	std::stringstream ss_milisec { };
-	ss_milisec << std::setw(3) << std::setfill('0') << std::stoi(milisec);
-	ss_milisec >> milisec;
-
-	std::stringstream ss_microsec { };
-	ss_microsec << std::setw(3) << std::setfill('0') << std::stoi(microsec);
-	ss_microsec >> microsec;
-
+	// The name is the capture time of the CPU, e.g. 20190318-182507-123456.jpg
 	ss1 << path;
-	ss1 << year;
-	ss1 << month;
-	ss1 << day;
-	ss1 << "-";
-	ss1 << hour;
-	ss1 << min;
-	ss1 << sec;
-	ss1 << "-";
-	ss1 << milisec;
-	ss1 << microsec;
-	ss1 << ".bmp";
-
-	std::string path_bmp;
-	ss1 >> path_bmp;
+	ss1 << formatHostTimeFileName(meta.captureTimeCPU);
+	ss1 << encoding.extension();
 
 	cv::Mat m;
-	try {
-		m = *p_openCvImage;
-		cv::hconcat(*p_openCvImage, *((dynamic_cast<ImagesCV &>(img2)).p_openCvImage), m);
-	} catch (...) {
-		m = *p_openCvImage;
+	if (img2.getImgBufferSize() != 0) {
+		cv::hconcat(openCvImage, img2.openCvImage, m);
+	} else {
+		m = openCvImage;
 	}
 
-	try {
-		imwrite(path_bmp, m);
-	} catch (std::exception & ex) {
-		std::cerr << "Error writing the bmp file for concatenated ImagesCV objects: " << ex.what() << std::endl;
-		throw ex;
+	writeImage(ss1.str(), m, encoding);
+}
+
+static StorageFile encodeImage(const std::string &name, const cv::Mat &m, const ImageEncoding &encoding) {
+// Encodes the image in memory, the file is written later by the storage
+	StorageFile f { };
+	f.name = name;
+	if (!cv::imencode(encoding.extension(), m, f.bytes, encoding.params())) {
+		throw std::runtime_error("Could not encode the " + encoding.format + " file " + name);
+	}
+	return f;
+}
+
+void ImagesCV::encodeData(std::vector<StorageFile> &files, const ImageEncoding &encoding) const {
+// Same file as saveData, encoded but not written
+	std::stringstream ss { };
+	ss << meta.cameraIdx << "_" << meta.frameId << encoding.extension();
+	files.push_back(encodeImage(ss.str(), openCvImage, encoding));
+}
+
+void ImagesCV::encodeDataConcat(const ImagesCV &img2, std::vector<StorageFile> &files, const ImageEncoding &encoding) const {
+// Same file as saveDataConcat, encoded but not written
+	cv::Mat m;
+	if (img2.getImgBufferSize() != 0) {
+		cv::hconcat(openCvImage, img2.openCvImage, m);
+	} else {
+		m = openCvImage;
 	}
+	files.push_back(encodeImage(formatHostTimeFileName(meta.captureTimeCPU) + encoding.extension(), m, encoding));
 }
 
 ImagesCV::~ImagesCV() {
-	delete p_openCvImage;
 }
 
 } /* namespace ScanVan */
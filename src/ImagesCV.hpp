@@ -3,28 +3,43 @@
 
 #include "Images.hpp"
 #include "ImagesRaw.hpp"
+#include "StorageFile.hpp"
+#include "ImageEncoding.hpp"
+
+#include <vector>
 
 namespace ScanVan {
 
 class ImagesCV: public Images {
 private:
-	cv::Mat * p_openCvImage;
+	// cv::Mat is reference counted: the copies of an image share the pixels.
+	// They are never modified in place, remap replaces the matrix. Call detach before writing into getMat.
+	cv::Mat openCvImage { };
 public:
 	ImagesCV();
-	ImagesCV(ImagesRaw &img);
-	ImagesCV(ImagesCV &img);
-	ImagesCV(ImagesCV &&img);
+	ImagesCV(const ImagesRaw &img);
+	ImagesCV(const ImagesRaw &img, const cv::Mat & map_1, const cv::Mat & map_2);
+	ImagesCV(const ImagesRaw &img, const cv::Mat &m);
+	ImagesCV(const ImagesCV &img) = default;
+	ImagesCV(ImagesCV &&img) = default;
 
 	void show () const;
 	void show (std::string name) const;
-	void showConcat (std::string name, Images &img2) const;
+	void showConcat (std::string name, const ImagesCV &img2) const;
 	void remap (const cv::Mat & map_1, const cv::Mat & map_2);
 	void saveImage (std::string path);
-	void saveData (std::string path);
-	void saveDataConcat (std::string path, Images &img2);
-
-	cv::Mat * getMat(){return p_openCvImage;}
-	size_t getImgBufferSize () const { return (*p_openCvImage).total() * (*p_openCvImage).elemSize();};
+	void saveData (std::string path, const ImageEncoding &encoding = ImageEncoding { });
+	void saveDataConcat (std::string path, const ImagesCV &img2, const ImageEncoding &encoding = ImageEncoding { });
+	void encodeData (std::vector<StorageFile> &files, const ImageEncoding &encoding = ImageEncoding { }) const;
+	void encodeDataConcat (const ImagesCV &img2, std::vector<StorageFile> &files, const ImageEncoding &encoding = ImageEncoding { }) const;
+
+	cv::Mat * getMat(){return &openCvImage;}
+	void setMat(const cv::Mat &m);
+	void detach();
+	size_t getImgBufferSize () const { return openCvImage.total() * openCvImage.elemSize(); };
+
+	ImagesCV & operator=(const ImagesCV &a) = default;
+	ImagesCV & operator=(ImagesCV &&a) = default;
 
 	virtual ~ImagesCV();
 };
@@ -17,13 +17,12 @@ namespace ScanVan {
 
 ImagesRaw::ImagesRaw(): Images{}{
 // Constructor
-	p_img = new std::vector<uint8_t> {};
+// The buffer is allocated when the image is copied or loaded
 }
 
 ImagesRaw::ImagesRaw(char * p): Images{}{
 // Constructor where it receives a pointer to a buffer
 // It copies the image to the object's buffer
-	p_img = new std::vector<uint8_t> {};
 	copyBuffer (p);
 }
 
@@ -32,8 +31,7 @@ ImagesRaw::ImagesRaw(size_t h, size_t w) : Images{} {
 // It reserves memory for the image
 	Images::setHeight(h);
 	Images::setWidth(w);
-	p_img = new std::vector<uint8_t> {};
-	p_img->reserve(height*width);
+	p_img = std::make_shared<HeapFrameBuffer>(height * width);
 
 }
 
@@ -43,50 +41,44 @@ ImagesRaw::ImagesRaw(size_t h, size_t w, char * p) : Images{} {
 
 	Images::setHeight(h);
 	Images::setWidth(w);
-	p_img = new std::vector<uint8_t> {};
 	copyBuffer(p);
 }
 
+ImagesRaw::ImagesRaw(size_t h, size_t w, std::shared_ptr<FrameBuffer> buf) : Images{} {
+// Constructor that takes the height and width and a buffer, e.g. borrowed from a FramePool
+// If buf is empty or too small, the buffer is allocated from the heap when the image is copied
+	Images::setHeight(h);
+	Images::setWidth(w);
+	if ((buf) && (buf->size() >= h * w)) {
+		p_img = std::move(buf);
+	}
+}
+
 ImagesRaw::ImagesRaw(std::string path) {
 // Constructor that takes the path to the file where the raw image is stored
 // It loads the image to the object's buffer
-	p_img = new std::vector<uint8_t> {};
 	loadImage(path);
 }
 
 ImagesRaw::ImagesRaw(const ImagesRaw &img): Images{} {
 // Copy constructor
-	p_img = new std::vector<uint8_t> {*(img.p_img)};
-	numImages = img.numImages;
-	cameraIdx = img.cameraIdx;
+// The pixels are shared with img, they are only copied if one of the two is written (see detach)
+	p_img = img.p_img;
+	height = img.height;
+	width = img.width;
+	meta = img.meta;
 	serialNum = img.serialNum;
-	captureTimeCPUStr = img.captureTimeCPUStr;
-	captureTimeCamStr = img.captureTimeCamStr;
-	exposureTime = img.exposureTime;
-	gain = img.gain;
-	balanceR = img.balanceR;
-	balanceG = img.balanceG;
-	balanceB = img.balanceB;
-	autoExpTime = img.autoExpTime;
-	autoGain = img.autoGain;
 }
 
 ImagesRaw::ImagesRaw(ImagesRaw &&img): Images{} {
 // Move constructor
-	p_img = img.p_img;
-	img.p_img = nullptr;
+// The buffer is handed over, the pixels are not copied
+	p_img = std::move(img.p_img);
 
-	cameraIdx = img.cameraIdx;
-	serialNum = img.serialNum;
-	captureTimeCPUStr = img.captureTimeCPUStr;
-	captureTimeCamStr = img.captureTimeCamStr;
-	exposureTime = img.exposureTime;
-	gain = img.gain;
-	balanceR = img.balanceR;
-	balanceG = img.balanceG;
-	balanceB = img.balanceB;
-	autoExpTime = img.autoExpTime;
-	autoGain = img.autoGain;
+	height = img.height;
+	width = img.width;
+	meta = img.meta;
+	serialNum = std::move(img.serialNum);
 }
 
 void ImagesRaw::getBuffer(char *p) const{
@@ -95,17 +87,38 @@ void ImagesRaw::getBuffer(char *p) const{
 }
 
 uint8_t* ImagesRaw::getBufferP () {
+// Returns the buffer for writing, the pixels are copied first if they are shared with another image
+	detach();
 	return p_img->data();
 }
 
+void ImagesRaw::detach() {
+// Copy on write: makes the buffer private to this object if other images share it
+	if ((p_img) && (p_img.use_count() > 1)) {
+		p_img = p_img->clone();
+	}
+}
+
 void ImagesRaw::copyBuffer(char *p) {
 // copies the image passed by the pointer p into the object's buffer
-	p_img->assign(p,p+(height*width));
+// the buffer is only allocated if the object does not have one large enough or shares it with another image
+	if ((!p_img) || (p_img->size() < height * width) || (p_img.use_count() > 1)) {
+		p_img = std::make_shared<HeapFrameBuffer>(height * width);
+	}
+	memcpy(p_img->data(), p, height * width);
+}
+
+void ImagesRaw::setBuffer(std::shared_ptr<FrameBuffer> buf) {
+// Attaches the buffer to the object without copying the image
+	if ((!buf) || (buf->size() < height * width)) {
+		throw std::runtime_error("The buffer is too small for the image in ImagesRaw::setBuffer.");
+	}
+	p_img = std::move(buf);
 }
 
 void ImagesRaw::loadImage(std::string path) {
 // Loads the images from the passed path.
-// The file needs to be a .raw file.
+// The file needs to be a .raw file, or a .rawc file written with the BayerCodec.
 	std::string ext = path.substr(path.find_last_of(".") + 1);
 	if (ext == "raw") {
 		std::ifstream myFile(path, std::ios::in | std::ios::binary);
@@ -114,15 +127,30 @@ void ImagesRaw::loadImage(std::string path) {
 			myFile.seekg(0, myFile.end);
 			int length = myFile.tellg();
 			myFile.seekg(0, myFile.beg);
-			p_img->reserve(length);
 
-			char * buffer = new char[length] { };
-			myFile.read(buffer, length);
-			p_img->assign(buffer, buffer + length);
+			// The file is read directly into the object's buffer
+			p_img = std::make_shared<HeapFrameBuffer>(length);
+			myFile.read(reinterpret_cast<char *>(p_img->data()), length);
 			myFile.close();
 		} else {
 			throw std::runtime_error("Image file extension not recognized.");
 		}
+	} else if (ext == "rawc") {
+		std::ifstream myFile(path, std::ios::in | std::ios::binary);
+		if (!myFile) {
+			throw std::runtime_error("Could not open the image file " + path);
+		}
+		std::vector<uint8_t> coded((std::istreambuf_iterator<char>(myFile)), std::istreambuf_iterator<char>());
+		myFile.close();
+		size_t h { };
+		size_t w { };
+		if (!BayerCodec::readSize(coded.data(), coded.size(), h, w)) {
+			throw std::runtime_error("The file " + path + " is not a compressed raw image.");
+		}
+		height = h;
+		width = w;
+		p_img = std::make_shared<HeapFrameBuffer>(height * width);
+		BayerCodec::shared().decode(coded.data(), coded.size(), p_img->data(), height, width);
 	} else {
 		throw std::runtime_error("Image file extension not recognized.");
 	}
@@ -166,9 +194,20 @@ void ImagesRaw::loadData(std::string path) {
 // The provided path is the base name and the extension will be appended.
 
 	std::string path_raw = path + ".raw";
+	std::ifstream test(path_raw);
+	if (!test) {
+		// The image may have been stored compressed
+		path_raw = path + ".rawc";
+	}
+	test.close();
 	loadImage (path_raw);
 
-	std::string path_data = path + ".txt";
+	loadCameraData (path + ".txt");
+}
+
+void ImagesRaw::parseCameraData(std::string path_data) {
+// It loads the camera parameters from the .txt file written by saveData, without printing them.
+
 	std::ifstream myFile(path_data);
 	if (myFile.is_open()) {
 		std::stringstream ss{};
@@ -178,17 +217,14 @@ void ImagesRaw::loadData(std::string path) {
 		getline(myFile, line);
 		std::string token = line.substr(line.find_last_of(":") + 1);
 		ss << token;
-		ss >> numImages;
-		std::cout << "Image Number: " << numImages << std::endl;
-
+		ss >> meta.frameId;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> cameraIdx;
-		std::cout << "Camera Index: " << cameraIdx << std::endl;
+		ss >> meta.cameraIdx;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
@@ -196,73 +232,67 @@ void ImagesRaw::loadData(std::string path) {
 		ss.clear();
 		ss << token;
 		ss >> serialNum;
-		std::cout << "Camera SN: " << serialNum << std::endl;
 
 		getline (myFile, line);
 		token = line.substr(line.find_first_of(":") + 1);
-		captureTimeCPUStr = token;
-		std::cout << "Capture Time CPU: " << captureTimeCPUStr;
+		meta.captureTimeCPU = parseHostTime(token);
 
 		getline(myFile, line);
 		token = line.substr(line.find_first_of(":") + 1);
-		captureTimeCamStr = token;
-		std::cout << "Capture Time Cam: " << captureTimeCamStr;
+		ss.str(std::string());
+		ss.clear();
+		ss << token;
+		meta.captureTimeCam = 0;
+		ss >> meta.captureTimeCam;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> exposureTime;
-		std::cout << "Exposure Time: " << exposureTime << std::endl;
+		ss >> meta.exposureTime;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> gain;
-		std::cout << "Gain: " << gain << std::endl;
+		ss >> meta.gain;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> balanceR;
-		std::cout << "Balance Red: " << balanceR << std::endl;
+		ss >> meta.balanceR;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> balanceG;
-		std::cout << "Balance Green: " << balanceG << std::endl;
+		ss >> meta.balanceG;
 
 		getline (myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> balanceB;
-		std::cout << "Balance Blue: " << balanceB << std::endl;
+		ss >> meta.balanceB;
 
 		getline(myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> autoExpTime;
-		std::cout << "Auto Exposure Time Continuous: " << autoExpTime << std::endl;
+		ss >> meta.autoExpTime;
 
 		getline(myFile, line);
 		token = line.substr(line.find_last_of(":") + 1);
 		ss.str(std::string());
 		ss.clear();
 		ss << token;
-		ss >> autoGain;
-		std::cout << "Auto Gain Continuous: " << autoGain << std::endl;
+		ss >> meta.autoGain;
 
 		myFile.close();
 	} else {
@@ -270,61 +300,135 @@ void ImagesRaw::loadData(std::string path) {
 	}
 }
 
+void ImagesRaw::loadCameraData(std::string path_data) {
+// It loads the camera parameters from the .txt file written by saveData and prints them.
+
+	parseCameraData(path_data);
+
+	std::cout << "Image Number: " << meta.frameId << std::endl;
+	std::cout << "Camera Index: " << meta.cameraIdx << std::endl;
+	std::cout << "Camera SN: " << serialNum << std::endl;
+	std::cout << "Capture Time CPU: " << formatHostTime(meta.captureTimeCPU) << std::endl;
+	std::cout << "Capture Time Cam: " << meta.captureTimeCam << std::endl;
+	std::cout << "Exposure Time: " << meta.exposureTime << std::endl;
+	std::cout << "Gain: " << meta.gain << std::endl;
+	std::cout << "Balance Red: " << meta.balanceR << std::endl;
+	std::cout << "Balance Green: " << meta.balanceG << std::endl;
+	std::cout << "Balance Blue: " << meta.balanceB << std::endl;
+	std::cout << "Auto Exposure Time Continuous: " << meta.autoExpTime << std::endl;
+	std::cout << "Auto Gain Continuous: " << meta.autoGain << std::endl;
+}
+
+
+std::string ImagesRaw::getRawFileName(bool compressed) const {
+// Name of the file where the raw image is stored: <camera index>_<image number>.raw, or .rawc when compressed
+	std::stringstream ss { };
+	ss << meta.cameraIdx;
+	ss << "_";
+	ss << meta.frameId;
+	ss << (compressed ? ".rawc" : ".raw");
+	return ss.str();
+}
+
+std::string ImagesRaw::getDataFileName() const {
+// Name of the file where the camera data is stored: img_<camera index>_<image number>.txt
+	std::stringstream ss { };
+	ss << "img_";
+	ss << meta.cameraIdx;
+	ss << "_";
+	ss << meta.frameId;
+	ss << ".txt";
+	return ss.str();
+}
+
+std::string ImagesRaw::formatData(const std::string &path_raw) const {
+// Returns the content of the camera data file
+	std::stringstream myFile { };
+	myFile << "Raw picture file: " << path_raw << std::endl;
+	myFile << "Image number: " << meta.frameId << std::endl;
+	myFile << "Camera Index: " << meta.cameraIdx << std::endl;
+	myFile << "Camera SN: " << serialNum << std::endl;
+	myFile << "Capture Time CPU: " << formatHostTime(meta.captureTimeCPU) << std::endl;
+	myFile << "Capture Time Cam: " << meta.captureTimeCam << std::endl;
+	myFile << "Exposure Time: " << meta.exposureTime << std::endl;
+	myFile << "Gain: " << meta.gain << std::endl;
+	myFile << "Balance Red  : " << meta.balanceR << std::endl;
+	myFile << "Balance Green: " << meta.balanceG << std::endl;
+	myFile << "Balance Blue : " << meta.balanceB << std::endl;
+	myFile << "Auto Exposure Time Continuous: " << meta.autoExpTime << std::endl;
+	myFile << "Auto Gain Continuous: " << meta.autoGain << std::endl;
+	return myFile.str();
+}
 
 void ImagesRaw::saveData(std::string path) {
+	saveData(path, nullptr);
+}
+
+void ImagesRaw::saveData(std::string path, BayerCodec *codec) {
 // Saves the raw image and the camera data to file
 // Here path is the path to the directory where the images will be stored.
 // The image number and the camera index are extracted from the object.
 // The function will automatically add the .raw for the raw data image and .txt for the camera
-// configuration.
-
-	std::stringstream ss1 { };
-
-	ss1 << path;
-	ss1 << cameraIdx;
-	ss1 << "_";
-	ss1 << numImages;
-	ss1 << ".raw";
-
-	std::stringstream ss2 { };
+// configuration. With a codec the image is compressed into a .rawc file.
 
-	ss2 << path;
-	ss2 << "img_";
-	ss2 << cameraIdx;
-	ss2 << "_";
-	ss2 << numImages;
-	ss2 << ".txt";
+	std::string path_raw = path + getRawFileName(codec != nullptr);
 
-	std::string path_raw;
-	ss1 >> path_raw;
-
-	saveImage (path_raw);
+	if (codec != nullptr) {
+		std::vector<uint8_t> coded { };
+		codec->encode(p_img->data(), height, width, coded);
+		std::ofstream myFile(path_raw, std::ios::out | std::ios::binary);
+		if (!myFile.write(reinterpret_cast<const char *>(coded.data()), coded.size())) {
+			throw std::runtime_error("Error to write the image file");
+		}
+	} else {
+		saveImage (path_raw);
+	}
 	//std::string path_bmp = path + ".bmp";
 	//saveImage (path_bmp);
 
-	std::string path_data;
-	ss2 >> path_data;
+	std::string path_data = path + getDataFileName();
 	std::ofstream myFile(path_data);
 	if (myFile.is_open()) {
-		myFile << "Raw picture file: " << path_raw << std::endl;
-		myFile << "Image number: " << numImages << std::endl;
-		myFile << "Camera Index: " << cameraIdx << std::endl;
-		myFile << "Camera SN: " << serialNum << std::endl;
-		myFile << "Capture Time CPU: " << captureTimeCPUStr << std::endl;
-		myFile << "Capture Time Cam: " << captureTimeCamStr << std::endl;
-		myFile << "Exposure Time: " << exposureTime << std::endl;
-		myFile << "Gain: " << gain << std::endl;
-		myFile << "Balance Red  : " << balanceR << std::endl;
-		myFile << "Balance Green: " << balanceG << std::endl;
-		myFile << "Balance Blue : " << balanceB << std::endl;
-		myFile << "Auto Exposure Time Continuous: " << autoExpTime << std::endl;
-		myFile << "Auto Gain Continuous: " << autoGain << std::endl;
+		myFile << formatData(path_raw);
 		myFile.close();
 	} else {
 		throw std::runtime_error ("Could not open the file to save camera data");
 	}
 }
 
+void ImagesRaw::encodeData(const std::string &path, BayerCodec *codec, std::vector<StorageFile> &files) const {
+// Prepares the files of saveData without writing them: the raw image, compressed with the codec if given,
+// and the camera data. path is only used for the reference to the raw file inside the camera data file.
+	StorageFile raw { };
+	raw.name = getRawFileName(codec != nullptr);
+	if (codec != nullptr) {
+		codec->encode(p_img->data(), height, width, raw.bytes);
+	} else {
+		raw.image = p_img;
+		raw.imageSize = height * width;
+	}
+
+	StorageFile data { };
+	data.name = getDataFileName();
+	data.commit = true;
+	std::string text = formatData(path + raw.name);
+	data.bytes.assign(text.begin(), text.end());
+
+	files.push_back(std::move(raw));
+	files.push_back(std::move(data));
+}
+
+void ImagesRaw::saveDataAt(int dirfd, std::string path, BayerCodec *codec) {
+// Same as saveData, but the files are created relative to the already opened directory dirfd.
+// It avoids resolving the path for every file and writes each file with a single system call.
+// path is only used for the reference to the raw file inside the camera data file.
+	std::vector<StorageFile> files { };
+	encodeData(path, codec, files);
+	for (const auto &f : files) {
+		f.writeAt(dirfd);
+	}
+}
+
 void ImagesRaw::show() const {
 // It shows the image in an opencv window with the title "Image"
 	cv::Mat openCvImageRG8 = cv::Mat(height, width, CV_8UC1, p_img->data());
@@ -356,7 +460,7 @@ void ImagesRaw::show (std::string name) const {
 }
 
 
-void ImagesRaw::showConcat (std::string name, Images &img2) const {
+void ImagesRaw::showConcat (std::string name, const ImagesRaw &img2) const {
 // shows the concatenated image in an opencv window with the name provided as parameter
 
 	cv::Mat m;
@@ -365,13 +469,13 @@ void ImagesRaw::showConcat (std::string name, Images &img2) const {
 	cv::Mat openCvImage;
 	cv::cvtColor(openCvImageRG8, openCvImage, cv::COLOR_BayerRG2RGB);
 
-	try {
-		cv::Mat openCvImageRG8_2 = cv::Mat(dynamic_cast<ImagesRaw &>(img2).height, dynamic_cast<ImagesRaw &>(img2).width, CV_8UC1, dynamic_cast<ImagesRaw &>(img2).p_img->data());
+	if (img2.getImgBufferSize() != 0) {
+		cv::Mat openCvImageRG8_2 = cv::Mat(img2.height, img2.width, CV_8UC1, img2.p_img->data());
 		cv::Mat openCvImage_2;
 		cv::cvtColor(openCvImageRG8_2, openCvImage_2, cv::COLOR_BayerRG2RGB);
 
 		cv::hconcat(openCvImage, openCvImage_2, m);
-	} catch (...) {
+	} else {
 		m = openCvImage;
 	}
 
@@ -441,19 +545,11 @@ time_t ImagesRaw::convertStringToTime (std::string str) {
 
 ImagesRaw & ImagesRaw::operator=(const ImagesRaw &a) {
 	if (this != &a) {
-		delete p_img;
-		p_img = new std::vector<uint8_t> {*(a.p_img)};
-		numImages = a.numImages;
-		cameraIdx = a.cameraIdx;
-		captureTimeCPUStr = a.captureTimeCPUStr;
-		captureTimeCamStr = a.captureTimeCamStr;
-		exposureTime = a.exposureTime;
-		gain = a.gain;
-		balanceR = a.balanceR;
-		balanceG = a.balanceG;
-		balanceB = a.balanceB;
-		autoExpTime = a.autoExpTime;
-		autoGain = a.autoGain;
+		// The pixels are shared, as in the copy constructor
+		p_img = a.p_img;
+		height = a.height;
+		width = a.width;
+		meta = a.meta;
 		serialNum = a.serialNum;
 	}
 	return *this;
@@ -461,27 +557,17 @@ ImagesRaw & ImagesRaw::operator=(const ImagesRaw &a) {
 
 ImagesRaw & ImagesRaw::operator=(ImagesRaw &&a) {
 	if (this != &a) {
-		delete p_img;
-		p_img = a.p_img;
-		a.p_img = nullptr;
-		numImages = a.numImages;
-		cameraIdx = a.cameraIdx;
-		captureTimeCPUStr = a.captureTimeCPUStr;
-		captureTimeCamStr = a.captureTimeCamStr;
-		exposureTime = a.exposureTime;
-		gain = a.gain;
-		balanceR = a.balanceR;
-		balanceG = a.balanceG;
-		balanceB = a.balanceB;
-		autoExpTime = a.autoExpTime;
-		autoGain = a.autoGain;
-		serialNum = a.serialNum;
+		p_img = std::move(a.p_img);
+		height = a.height;
+		width = a.width;
+		meta = a.meta;
+		serialNum = std::move(a.serialNum);
 	}
 	return *this;
 }
 
 ImagesRaw::~ImagesRaw() {
-	delete p_img;
+// The buffer is released, or returned to its pool, when the last reference is destroyed
 }
 
 } /* namespace ScanVan */
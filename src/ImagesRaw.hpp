@@ -18,8 +18,15 @@
 #include <fstream>
 #include <chrono>
 #include <sstream>
+#include <iterator>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "Images.hpp"
+#include "FrameBuffer.hpp"
+#include "BayerCodec.hpp"
+#include "StorageFile.hpp"
 
 // Include files to use OpenCV API
 #include <opencv2/opencv.hpp>
@@ -30,7 +37,9 @@ namespace ScanVan {
 
 class ImagesRaw: public Images {
 private:
-	std::vector<uint8_t> * p_img;
+	// The pixels are shared between the copies of an image and treated as immutable.
+	// Writing through getBufferP copies them first if they are shared (copy on write).
+	std::shared_ptr<FrameBuffer> p_img { };
 
 protected:
 	std::string convertTimeToString (time_t t);
@@ -41,23 +50,35 @@ public:
 	ImagesRaw(char * p);
 	ImagesRaw(size_t h, size_t w);
 	ImagesRaw(size_t h, size_t w, char * p);
+	ImagesRaw(size_t h, size_t w, std::shared_ptr<FrameBuffer> buf);
 	ImagesRaw(std::string path);
 	ImagesRaw(const ImagesRaw &img);
 	ImagesRaw(ImagesRaw &&img);
 
-	size_t getImgBufferSize () const { return p_img->size(); };
+	size_t getImgBufferSize () const { return (p_img) ? height * width : 0; };
 
 	void getBuffer (char *p) const;
 	void copyBuffer (char *p);
+	void setBuffer (std::shared_ptr<FrameBuffer> buf);
 	uint8_t* getBufferP ();
+	const uint8_t* getData () const { return (p_img) ? p_img->data() : nullptr; };
+	void detach ();
 
 	void loadImage (std::string path);
 	void saveImage (std::string path);
 	void loadData (std::string path);
+	void loadCameraData (std::string path_data);
+	void parseCameraData (std::string path_data);
 	void saveData (std::string path);
+	void saveData (std::string path, BayerCodec *codec);
+	void saveDataAt (int dirfd, std::string path, BayerCodec *codec = nullptr);
+	void encodeData (const std::string &path, BayerCodec *codec, std::vector<StorageFile> &files) const;
+	std::string getRawFileName (bool compressed = false) const;
+	std::string getDataFileName () const;
+	std::string formatData (const std::string &path_raw) const;
 	void show () const;
 	void show (std::string name) const;
-	void showConcat (std::string name, Images &img2) const;
+	void showConcat (std::string name, const ImagesRaw &img2) const;
 
 	cv::Mat convertToCvMat ();
 
@@ -69,21 +90,21 @@ public:
 	friend std::ostream & operator <<(std::ostream & out, const ImagesRaw &a) {
 		out << "[";
 		for (int i=0; i < 10; ++i) {
-			out << static_cast<int>((*a.p_img)[i]) << " ";
+			out << static_cast<int>(a.p_img->data()[i]) << " ";
 		}
 		out << "...]" << std::endl;
 		out << "height: " << a.height << std::endl;
 		out << "width: " << a.width << std::endl;
-		out << "cameraIdx: " << a.cameraIdx << std::endl;
-		out << "captureCPUTime: " << a.captureTimeCPUStr << std::endl;
-		out << "captureCamTime: " << a.captureTimeCamStr << std::endl;
-		out << "exposureTime: " << a.exposureTime << std::endl;
-		out << "gain: " << a.gain << std::endl;
-		out << "balanceR: " << a.balanceR << std::endl;
-		out << "balanceG: " << a.balanceG << std::endl;
-		out << "balanceB: " << a.balanceB << std::endl;
-		out << "autoExpTime: " << a.autoExpTime << std::endl;
-		out << "autoGain: " << a.autoGain << std::endl;
+		out << "cameraIdx: " << a.meta.cameraIdx << std::endl;
+		out << "captureCPUTime: " << formatHostTime(a.meta.captureTimeCPU) << std::endl;
+		out << "captureCamTime: " << a.meta.captureTimeCam << std::endl;
+		out << "exposureTime: " << a.meta.exposureTime << std::endl;
+		out << "gain: " << a.meta.gain << std::endl;
+		out << "balanceR: " << a.meta.balanceR << std::endl;
+		out << "balanceG: " << a.meta.balanceG << std::endl;
+		out << "balanceB: " << a.meta.balanceB << std::endl;
+		out << "autoExpTime: " << a.meta.autoExpTime << std::endl;
+		out << "autoGain: " << a.meta.autoGain << std::endl;
 
 		return out;
 	}
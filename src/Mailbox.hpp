@@ -0,0 +1,150 @@
+//============================================================================
+// Name        : Mailbox.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Single-producer/single-consumer channel that only keeps the
+//				 latest element (triple buffer). The producer never waits and
+//				 the consumer always gets the newest element, so a slow
+//				 consumer skips elements instead of building a backlog.
+//============================================================================
+
+#ifndef MAILBOX_HPP_
+#define MAILBOX_HPP_
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "RingBuffer.hpp"
+
+namespace ScanVan {
+
+template<typename T>
+class spsc_mailbox {
+public:
+	// Elements that may be alive in the mailbox at the same time
+	static constexpr size_t num_slots = 3;
+
+private:
+	// The slots are exchanged between the producer (back), the consumer (front) and the middle.
+	// The middle holds the index of its slot and the flag fresh when it has not been taken yet.
+	static constexpr unsigned fresh = 4;
+	static constexpr unsigned index_mask = 3;
+
+	T slots[num_slots] { };
+	alignas(cache_line_size) unsigned back { 0 };				// owned by the producer
+	alignas(cache_line_size) unsigned front { 1 };				// owned by the consumer
+	alignas(cache_line_size) std::atomic<unsigned> middle { 2 };
+	alignas(cache_line_size) std::atomic<size_t> dropped { 0 };	// elements replaced before the consumer took them
+	std::atomic<int> waiters { 0 };
+	std::atomic<bool> closed { false };	// once closed, no element is accepted and the waits return when the mailbox is empty
+
+	// Only used to put the consumer to sleep when the mailbox is empty
+	std::mutex m;
+	std::condition_variable cv;
+
+	void notify() {
+		// The lock is only taken if there is somebody waiting
+		if (waiters.load() > 0) {
+			std::lock_guard<std::mutex> lg { m };
+			cv.notify_all();
+		}
+	}
+
+	template<typename Predicate, typename Rep, typename Period>
+	bool wait_for(Predicate pred, const std::chrono::duration<Rep, Period> &timeout) {
+		if (pred()) return true;
+		std::unique_lock<std::mutex> lg { m };
+		++waiters;
+		bool res = cv.wait_for(lg, timeout, pred);
+		--waiters;
+		return res;
+	}
+
+	template<typename U>
+	bool put(U &&value) {
+		if (closed.load()) {
+			return false;
+		}
+		slots[back] = std::forward<U>(value);
+		unsigned prev = middle.exchange(back | fresh);
+		back = prev & index_mask;
+		if (prev & fresh) {
+			// The consumer never saw the previous element, release it now rather than at the next push
+			++dropped;
+			slots[back] = T { };
+		}
+		notify();
+		return true;
+	}
+
+public:
+	spsc_mailbox() {};
+	spsc_mailbox(spsc_mailbox const & other) = delete;
+	spsc_mailbox & operator=(spsc_mailbox const & other) = delete;
+
+	// Replaces the element waiting in the mailbox, if any. Returns false after close.
+	bool push(const T& value) {
+		return put(value);
+	}
+
+	bool push(T&& value) {
+		return put(std::move(value));
+	}
+
+	bool pop(T& ref) {
+		// Takes the latest element, returns false if there is none since the last pop
+		if ((middle.load() & fresh) == 0) {
+			return false;
+		}
+		unsigned prev = middle.exchange(front);
+		front = prev & index_mask;
+		ref = std::move(slots[front]);
+		return true;
+	}
+
+	void close() {
+		// Wakes up the consumer. The element already in the mailbox can still be taken.
+		std::lock_guard<std::mutex> lg { m };
+		closed.store(true);
+		cv.notify_all();
+	}
+
+	bool is_closed() const {
+		return closed.load();
+	}
+
+	template<typename Rep, typename Period>
+	bool wait_pop_for(T& ref, const std::chrono::duration<Rep, Period> &timeout) {
+		// Returns false if the mailbox is closed and empty or if the timeout expires
+		if (pop(ref)) {
+			return true;
+		}
+		wait_for([this] {return !empty() || closed.load();}, timeout);
+		return pop(ref);
+	}
+
+	void flush() {
+		// Only to be called from the consumer
+		T discard { };
+		pop(discard);
+	}
+
+	bool empty() const {
+		return (middle.load() & fresh) == 0;
+	}
+
+	size_t size() const {
+		return empty() ? 0 : 1;
+	}
+
+	size_t getDropped() const {
+		return dropped.load();
+	}
+};
+
+} /* namespace ScanVan */
+
+#endif /* MAILBOX_HPP_ */
@@ -0,0 +1,251 @@
+//============================================================================
+// Name        : MapCache.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Binary cache of the calibration maps of one camera.
+//============================================================================
+
+#include "MapCache.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ScanVan {
+
+static const char cacheMagic[8] = { 'S', 'V', 'M', 'A', 'P', 'S', '\0', '\0' };
+
+// Types of map1f, map2f, map1s, map2s and the size of their elements
+static const int matTypes[4] = { CV_32FC1, CV_32FC1, CV_16SC2, CV_16UC1 };
+static const size_t matElemSizes[4] = { 4, 4, 4, 2 };
+
+MapCache::MapCache(const std::string &dir, const std::string &serial) : dir { dir }, serial { serial } {
+	if ((!this->dir.empty()) && (this->dir.back() != '/')) {
+		this->dir += "/";
+	}
+	xmlPath[0] = this->dir + "map1.xml";
+	xmlPath[1] = this->dir + "map2.xml";
+	cachePath = this->dir + "maps.bin";
+}
+
+MapCache::Stamp MapCache::GetStamp(const std::string &path) {
+	Stamp s { };
+	struct stat st { };
+	if (stat(path.c_str(), &st) == 0) {
+		s.size = static_cast<int64_t>(st.st_size);
+		s.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+	}
+	return s;
+}
+
+uint64_t MapCache::HashSources() const {
+// FNV-1a over the content of map1.xml followed by map2.xml
+	uint64_t h = 14695981039346656037ULL;
+	std::vector<char> buffer(1 << 20);
+	for (const std::string &path : xmlPath) {
+		std::ifstream myFile(path, std::ios::in | std::ios::binary);
+		while (myFile) {
+			myFile.read(buffer.data(), buffer.size());
+			std::streamsize n = myFile.gcount();
+			for (std::streamsize i = 0; i < n; ++i) {
+				h ^= static_cast<uint8_t>(buffer[i]);
+				h *= 1099511628211ULL;
+			}
+		}
+	}
+	return h;
+}
+
+bool MapCache::Read(CalibrationMaps &maps) {
+// Maps the cache into memory if it is valid for the serial number and the XML files
+
+	int fd = open(cachePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st { };
+	Header h { };
+	bool valid = (fstat(fd, &st) == 0) && (pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)));
+	valid = valid && (memcmp(h.magic, cacheMagic, sizeof(cacheMagic)) == 0) && (h.version == version) && (h.numMats == 4);
+	valid = valid && (strncmp(h.serial, serial.c_str(), sizeof(h.serial)) == 0);
+
+	Stamp s[2] { };
+	bool restamp = false;
+	if (valid) {
+		s[0] = GetStamp(xmlPath[0]);
+		s[1] = GetStamp(xmlPath[1]);
+		if ((s[0].size >= 0) && (s[1].size >= 0)) {
+			bool sameStamps = (s[0].size == h.source[0].size) && (s[0].mtime == h.source[0].mtime)
+					&& (s[1].size == h.source[1].size) && (s[1].mtime == h.source[1].mtime);
+			if (!sameStamps) {
+				// The XML files were touched, e.g. copied again: the content decides
+				valid = (HashSources() == h.sourceHash);
+				restamp = valid;
+			}
+		}
+		// Without the XML files the cache is used as it is
+	}
+
+	for (size_t i = 0; valid && (i < 4); ++i) {
+		const MatEntry &e = h.mats[i];
+		valid = (e.type == matTypes[i]) && (e.rows == h.mats[0].rows) && (e.cols == h.mats[0].cols)
+				&& (e.bytes == static_cast<uint64_t>(e.rows) * e.cols * matElemSizes[i])
+				&& (e.offset + e.bytes <= static_cast<uint64_t>(st.st_size));
+	}
+
+	if (!valid) {
+		close(fd);
+		return false;
+	}
+
+	if (restamp) {
+		// Same content under new stamps, they are kept so the next start does not hash the XML files again
+		WriteStamps(s);
+	}
+
+	// Private mapping: the pages come from the page cache and are only copied if this process writes them
+	size_t length = static_cast<size_t>(st.st_size);
+	void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+
+	maps.storage = std::shared_ptr<void>(p, [length](void *q) { munmap(q, length); });
+	uint8_t *base = static_cast<uint8_t *>(p);
+	cv::Mat *mats[4] = { &maps.map1f, &maps.map2f, &maps.map1s, &maps.map2s };
+	for (size_t i = 0; i < 4; ++i) {
+		*mats[i] = cv::Mat(h.mats[i].rows, h.mats[i].cols, h.mats[i].type, base + h.mats[i].offset);
+	}
+	return true;
+}
+
+void MapCache::Write(const CalibrationMaps &maps, uint64_t hash, const Stamp source[2]) {
+// Writes the cache to a temporary file that replaces the old one, so a process that reads it
+// at the same time sees either the old or the new cache. A failure only costs the next start.
+
+	const cv::Mat *mats[4] = { &maps.map1f, &maps.map2f, &maps.map1s, &maps.map2s };
+	for (size_t i = 0; i < 4; ++i) {
+		if ((mats[i]->type() != matTypes[i]) || (mats[i]->size() != maps.map1f.size())) {
+			std::cerr << "The maps of " << serial << " are not of the expected types, they are not cached." << std::endl;
+			return;
+		}
+	}
+
+	Header h { };
+	memcpy(h.magic, cacheMagic, sizeof(cacheMagic));
+	h.version = version;
+	h.numMats = 4;
+	strncpy(h.serial, serial.c_str(), sizeof(h.serial) - 1);
+	h.sourceHash = hash;
+	h.source[0] = source[0];
+	h.source[1] = source[1];
+
+	const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	uint64_t offset = (sizeof(h) + pageSize - 1) / pageSize * pageSize;
+	for (size_t i = 0; i < 4; ++i) {
+		MatEntry &e = h.mats[i];
+		e.type = matTypes[i];
+		e.rows = mats[i]->rows;
+		e.cols = mats[i]->cols;
+		e.offset = offset;
+		e.bytes = static_cast<uint64_t>(e.rows) * e.cols * matElemSizes[i];
+		offset += (e.bytes + pageSize - 1) / pageSize * pageSize;
+	}
+
+	std::stringstream ss { };
+	ss << cachePath << ".tmp" << getpid();
+	std::string tmpPath = ss.str();
+
+	int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		std::cerr << "Could not create the map cache " << tmpPath << ", the XML files will be parsed again at the next start." << std::endl;
+		return;
+	}
+
+	bool ok = (pwrite(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h)));
+	for (size_t i = 0; ok && (i < 4); ++i) {
+		const size_t rowBytes = static_cast<size_t>(h.mats[i].cols) * matElemSizes[i];
+		for (int r = 0; ok && (r < h.mats[i].rows); ++r) {
+			off_t pos = static_cast<off_t>(h.mats[i].offset + r * rowBytes);
+			ok = (pwrite(fd, mats[i]->ptr<uint8_t>(r), rowBytes, pos) == static_cast<ssize_t>(rowBytes));
+		}
+	}
+	ok = (close(fd) == 0) && ok;
+	ok = ok && (rename(tmpPath.c_str(), cachePath.c_str()) == 0);
+
+	if (ok) {
+		std::cout << "Wrote " << cachePath << std::endl;
+	} else {
+		unlink(tmpPath.c_str());
+		std::cerr << "Could not write the map cache " << cachePath << ", the XML files will be parsed again at the next start." << std::endl;
+	}
+}
+
+void MapCache::WriteStamps(const Stamp source[2]) {
+// Updates the stamps of the XML files in the header of the cache in place. The header page is not part of
+// the maps, so the processes that have the cache mapped are not affected. A failure only costs the hash.
+
+	Stamp stamps[2] { source[0], source[1] };
+	int fd = open(cachePath.c_str(), O_WRONLY | O_CLOEXEC);
+	bool ok = (fd >= 0) && (pwrite(fd, stamps, sizeof(stamps), offsetof(Header, source)) == static_cast<ssize_t>(sizeof(stamps)));
+	if (fd >= 0) {
+		ok = (close(fd) == 0) && ok;
+	}
+	if (!ok) {
+		std::cerr << "Could not update the stamps of " << cachePath << ", the XML files will be hashed again at the next start." << std::endl;
+	}
+}
+
+CalibrationMaps MapCache::ParseXml() const {
+	CalibrationMaps maps { };
+
+	cv::FileStorage file_1(xmlPath[0], cv::FileStorage::READ);
+	if (file_1.isOpened()) {
+		file_1["mat_map1"] >> maps.map1f;
+		file_1.release();
+		std::cout << "Read " << xmlPath[0] << std::endl;
+	} else {
+		throw std::runtime_error("Could not load " + xmlPath[0] + ".");
+	}
+
+	cv::FileStorage file_2(xmlPath[1], cv::FileStorage::READ);
+	if (file_2.isOpened()) {
+		file_2["mat_map2"] >> maps.map2f;
+		file_2.release();
+		std::cout << "Read " << xmlPath[1] << std::endl;
+	} else {
+		throw std::runtime_error("Could not load " + xmlPath[1] + ".");
+	}
+
+	cv::convertMaps(maps.map1f, maps.map2f, maps.map1s, maps.map2s, CV_16SC2);
+	return maps;
+}
+
+CalibrationMaps MapCache::Load() {
+	CalibrationMaps maps { };
+	if (Read(maps)) {
+		std::cout << "Mapped " << cachePath << " (SN:" << serial << ")" << std::endl;
+		return maps;
+	}
+
+	// The stamps and the hash are taken before parsing, a change during the parsing is seen at the next start
+	Stamp source[2] { GetStamp(xmlPath[0]), GetStamp(xmlPath[1]) };
+	uint64_t hash = HashSources();
+	maps = ParseXml();
+	Write(maps, hash, source);
+	return maps;
+}
+
+} /* namespace ScanVan */
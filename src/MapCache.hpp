@@ -0,0 +1,85 @@
+//============================================================================
+// Name        : MapCache.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Binary cache of the calibration maps of one camera. The
+//				 float maps of map1.xml and map2.xml and the fixed point maps
+//				 given by cv::convertMaps are stored in maps.bin next to the
+//				 XML files and mapped into memory at start, so the XML is
+//				 parsed only when it changes. The pages of the file are
+//				 shared by all the processes that map it; a process that
+//				 writes into a map gets a private copy of the touched pages.
+//============================================================================
+
+#ifndef MAPCACHE_HPP_
+#define MAPCACHE_HPP_
+
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+// Include files to use OpenCV API
+#include <opencv2/opencv.hpp>
+
+namespace ScanVan {
+
+struct CalibrationMaps {
+	cv::Mat map1f;		// CV_32FC1, x of the source for each output pixel
+	cv::Mat map2f;		// CV_32FC1, y of the source for each output pixel
+	cv::Mat map1s;		// CV_16SC2, integer positions
+	cv::Mat map2s;		// CV_16UC1, fractional parts
+	std::shared_ptr<void> storage { };	// keeps the mapped cache alive as long as the matrices point into it
+};
+
+class MapCache {
+private:
+	static const uint32_t version = 1;
+
+	struct Stamp {
+		int64_t size = -1;		// -1 when the file does not exist
+		int64_t mtime = 0;		// nanoseconds
+	};
+
+	struct MatEntry {
+		int32_t type;
+		int32_t rows;
+		int32_t cols;
+		int32_t reserved;
+		uint64_t offset;		// from the start of the file, multiple of the page size
+		uint64_t bytes;
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t numMats;
+		char serial[64];
+		uint64_t sourceHash;	// FNV-1a of map1.xml followed by map2.xml
+		Stamp source[2];		// size and modification time of map1.xml and map2.xml
+		MatEntry mats[4];		// map1f, map2f, map1s, map2s
+	};
+
+	std::string dir;			// calibration directory of the camera, ends with '/'
+	std::string serial;
+	std::string xmlPath[2];
+	std::string cachePath;
+
+	static Stamp GetStamp(const std::string &path);
+	uint64_t HashSources() const;
+	bool Read(CalibrationMaps &maps);
+	void Write(const CalibrationMaps &maps, uint64_t hash, const Stamp source[2]);
+	void WriteStamps(const Stamp source[2]);
+	CalibrationMaps ParseXml() const;
+
+public:
+	MapCache(const std::string &dir, const std::string &serial);
+
+	// Returns the maps from the cache, or parses the XML files and rewrites the cache
+	// when it is missing, of another version or older than the XML files.
+	CalibrationMaps Load();
+};
+
+} /* namespace ScanVan */
+
+#endif /* MAPCACHE_HPP_ */
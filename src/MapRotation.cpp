@@ -0,0 +1,158 @@
+//============================================================================
+// Name        : MapRotation.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Rotation of the equirectangular maps around the x axis.
+//============================================================================
+
+#include "MapRotation.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ScanVan {
+
+// Number of pixels of a row processed at once, the intermediate values stay on the stack
+static const int chunkSize = 256;
+
+static inline float atan2Poly(float y, float x) {
+// atan2 without branches, the error is below 1e-5 rad (0.01 pixel on a 3008 pixel wide map)
+	float ax = std::fabs(x);
+	float ay = std::fabs(y);
+	float mx = std::max(ax, ay);
+	float mn = std::min(ax, ay);
+	float a = mn / (mx + 1e-30f);
+	float s = a * a;
+	float r = (((((-0.01172120f * s + 0.05265332f) * s - 0.11643287f) * s + 0.19354346f) * s - 0.33262347f) * s + 0.99997726f) * a;
+	r = (ay > ax) ? static_cast<float>(M_PI_2) - r : r;
+	r = (x < 0) ? static_cast<float>(M_PI) - r : r;
+	r = (y < 0) ? -r : r;
+	return r;
+}
+
+MapRotation::MapRotation(int rows, int cols, float alpha) :
+		rows { rows }, cols { cols }, alpha { alpha }, cosAlpha { std::cos(alpha) }, sinAlpha { std::sin(alpha) } {
+	cosTheta.resize(cols);
+	sinTheta.resize(cols);
+	for (int x = 0; x < cols; ++x) {
+		double theta = M_PI * x / cols - M_PI / 2;
+		cosTheta[x] = static_cast<float>(std::cos(theta));
+		sinTheta[x] = static_cast<float>(std::sin(theta));
+	}
+	cosPhi.resize(rows);
+	sinPhi.resize(rows);
+	for (int y = 0; y < rows; ++y) {
+		double phi = M_PI / 2 - M_PI * y / rows;
+		cosPhi[y] = static_cast<float>(std::cos(phi));
+		sinPhi[y] = static_cast<float>(std::sin(phi));
+	}
+}
+
+void MapRotation::positions(int y, int x0, int n, float *xRot, float *yRot) const {
+// Point of the sphere of each pixel, rotated around x, and back to the equirectangular coordinates
+
+	const float cp = cosPhi[y];
+	const float sp = sinPhi[y];
+	const float *ct = cosTheta.data() + x0;
+	const float *st = sinTheta.data() + x0;
+	const float scaleX = static_cast<float>(cols / M_PI);
+	const float scaleY = static_cast<float>(rows / M_PI);
+
+	for (int i = 0; i < n; ++i) {
+		float s0 = ct[i] * cp;
+		float s1 = st[i] * cp;
+		float r1 = s1 * cosAlpha - sp * sinAlpha;
+		float r2 = s1 * sinAlpha + sp * cosAlpha;
+		float thetaRot = atan2Poly(r1, s0);
+		float phiRot = atan2Poly(r2, std::sqrt(s0 * s0 + r1 * r1));
+		xRot[i] = (thetaRot + static_cast<float>(M_PI_2)) * scaleX;
+		yRot[i] = (static_cast<float>(M_PI_2) - phiRot) * scaleY;
+	}
+}
+
+void MapRotation::sampleRow(const cv::Mat &mapX, const cv::Mat &mapY, int y, int x0, int n, float *outX, float *outY) const {
+	float xRot[chunkSize];
+	float yRot[chunkSize];
+
+	for (int c = 0; c < n; c += chunkSize) {
+		const int m = std::min(chunkSize, n - c);
+		positions(y, x0 + c, m, xRot, yRot);
+
+		// Bilinear interpolation of the maps at the rotated positions
+		for (int i = 0; i < m; ++i) {
+			int xi = static_cast<int>(xRot[i]) % cols;
+			int yi = static_cast<int>(yRot[i]) % rows;
+			if ((xi > 0) && (xi < cols - 1) && (yi > 0) && (yi < rows - 1)) {
+				float xfb = xRot[i] - static_cast<int>(xRot[i]);
+				float yfb = yRot[i] - static_cast<int>(yRot[i]);
+				float xfa = 1.0f - xfb;
+				float yfa = 1.0f - yfb;
+				const float *mx0 = mapX.ptr<float>(yi) + xi;
+				const float *mx1 = mapX.ptr<float>(yi + 1) + xi;
+				const float *my0 = mapY.ptr<float>(yi) + xi;
+				const float *my1 = mapY.ptr<float>(yi + 1) + xi;
+				outX[c + i] = (mx0[0] * xfa + mx0[1] * xfb) * yfa + (mx1[0] * xfa + mx1[1] * xfb) * yfb;
+				outY[c + i] = (my0[0] * xfa + my0[1] * xfb) * yfa + (my1[0] * xfa + my1[1] * xfb) * yfb;
+			} else {
+				outX[c + i] = 0;
+				outY[c + i] = 0;
+			}
+		}
+	}
+}
+
+void toFixedPoint(const float *x, const float *y, int n, int16_t *xy, uint16_t *frac) {
+// Same rounding as cv::convertMaps
+	const int tabMask = cv::INTER_TAB_SIZE - 1;
+	for (int i = 0; i < n; ++i) {
+		int iu = cvRound(x[i] * cv::INTER_TAB_SIZE);
+		int iv = cvRound(y[i] * cv::INTER_TAB_SIZE);
+		xy[2 * i] = static_cast<int16_t>(std::min(std::max(iu >> cv::INTER_BITS, -32768), 32767));
+		xy[2 * i + 1] = static_cast<int16_t>(std::min(std::max(iv >> cv::INTER_BITS, -32768), 32767));
+		frac[i] = static_cast<uint16_t>((iv & tabMask) * cv::INTER_TAB_SIZE + (iu & tabMask));
+	}
+}
+
+static void checkFloatMaps(const cv::Mat &mapX, const cv::Mat &mapY) {
+	if ((mapX.type() != CV_32FC1) || (mapY.type() != CV_32FC1) || (mapX.size() != mapY.size())) {
+		throw std::runtime_error("The rotation needs two float maps (CV_32FC1) of the same size.");
+	}
+}
+
+void rotateMap(const cv::Mat &mapX, const cv::Mat &mapY, cv::Mat &mapXRot, cv::Mat &mapYRot, float alpha) {
+	checkFloatMaps(mapX, mapY);
+	MapRotation rot { mapX.rows, mapX.cols, alpha };
+
+	mapXRot.create(mapX.rows, mapX.cols, CV_32FC1);
+	mapYRot.create(mapX.rows, mapX.cols, CV_32FC1);
+
+	cv::parallel_for_(cv::Range(0, mapX.rows), [&](const cv::Range &range) {
+		for (int y = range.start; y < range.end; ++y) {
+			rot.sampleRow(mapX, mapY, y, 0, mapX.cols, mapXRot.ptr<float>(y), mapYRot.ptr<float>(y));
+		}
+	});
+}
+
+void rotateMapFixed(const cv::Mat &mapX, const cv::Mat &mapY, cv::Mat &map_1, cv::Mat &map_2, float alpha) {
+	checkFloatMaps(mapX, mapY);
+	MapRotation rot { mapX.rows, mapX.cols, alpha };
+
+	map_1.create(mapX.rows, mapX.cols, CV_16SC2);
+	map_2.create(mapX.rows, mapX.cols, CV_16UC1);
+
+	cv::parallel_for_(cv::Range(0, mapX.rows), [&](const cv::Range &range) {
+		float outX[chunkSize];
+		float outY[chunkSize];
+		for (int y = range.start; y < range.end; ++y) {
+			for (int x0 = 0; x0 < mapX.cols; x0 += chunkSize) {
+				const int n = std::min(chunkSize, mapX.cols - x0);
+				rot.sampleRow(mapX, mapY, y, x0, n, outX, outY);
+				toFixedPoint(outX, outY, n, map_1.ptr<int16_t>(y) + 2 * x0, map_2.ptr<uint16_t>(y) + x0);
+			}
+		}
+	});
+}
+
+} /* namespace ScanVan */
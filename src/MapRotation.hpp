@@ -0,0 +1,61 @@
+//============================================================================
+// Name        : MapRotation.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Rotation of the equirectangular maps around the x axis, used
+//				 to calibrate the roll between the two cameras. The sines and
+//				 cosines of the columns and rows are tabulated once per map
+//				 size, the inner loops have no branches so the compiler can
+//				 vectorize them, and the rows are processed in parallel.
+//============================================================================
+
+#ifndef MAPROTATION_HPP_
+#define MAPROTATION_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+// Include files to use OpenCV API
+#include <opencv2/opencv.hpp>
+
+namespace ScanVan {
+
+class MapRotation {
+private:
+	int rows;
+	int cols;
+	float alpha;
+	float cosAlpha;
+	float sinAlpha;
+	std::vector<float> cosTheta { };	// per column, theta = pi * x / cols - pi / 2
+	std::vector<float> sinTheta { };
+	std::vector<float> cosPhi { };		// per row, phi = pi / 2 - pi * y / rows
+	std::vector<float> sinPhi { };
+
+public:
+	MapRotation(int rows, int cols, float alpha);
+
+	// Positions in the map before the rotation of the n pixels from (x0, y) of the rotated map
+	void positions(int y, int x0, int n, float *xRot, float *yRot) const;
+
+	// Value of the rotated maps for the n pixels from (x0, y), 0 where the position falls outside of the map
+	void sampleRow(const cv::Mat &mapX, const cv::Mat &mapY, int y, int x0, int n, float *outX, float *outY) const;
+
+	float getAlpha() const { return alpha; }
+	int getRows() const { return rows; }
+	int getCols() const { return cols; }
+};
+
+// Converts n positions to the fixed point format of cv::convertMaps (CV_16SC2, CV_16UC1)
+void toFixedPoint(const float *x, const float *y, int n, int16_t *xy, uint16_t *frac);
+
+// Rotates the float maps by alpha around the x axis
+void rotateMap(const cv::Mat &mapX, const cv::Mat &mapY, cv::Mat &mapXRot, cv::Mat &mapYRot, float alpha);
+
+// Same as rotateMap followed by cv::convertMaps to CV_16SC2, without the intermediate float maps
+void rotateMapFixed(const cv::Mat &mapX, const cv::Mat &mapY, cv::Mat &map_1, cv::Mat &map_2, float alpha);
+
+} /* namespace ScanVan */
+
+#endif /* MAPROTATION_HPP_ */
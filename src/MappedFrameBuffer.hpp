@@ -0,0 +1,45 @@
+//============================================================================
+// Name        : MappedFrameBuffer.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Frame buffer that points into a file mapped into memory, the
+//				 image is read by the page faults instead of being copied.
+//				 The mapping stays alive as long as an image refers to it.
+//============================================================================
+
+#ifndef MAPPEDFRAMEBUFFER_HPP_
+#define MAPPEDFRAMEBUFFER_HPP_
+
+#include <memory>
+#include <stdint.h>
+
+#include "FrameBuffer.hpp"
+
+namespace ScanVan {
+
+class MappedFrameBuffer: public FrameBuffer {
+private:
+	// The file is mapped private: writing into the image gives the process its own copy of the pages
+	std::shared_ptr<void> mapping;
+	uint8_t *p;
+	size_t n;
+public:
+	MappedFrameBuffer(const std::shared_ptr<void> &mapping, uint8_t *p, size_t n) : mapping { mapping }, p { p }, n { n } {};
+	MappedFrameBuffer(const MappedFrameBuffer &) = delete;
+	MappedFrameBuffer & operator=(const MappedFrameBuffer &) = delete;
+
+	uint8_t * data() { return p; };
+	const uint8_t * data() const { return p; };
+	size_t size() const { return n; };
+
+	std::shared_ptr<FrameBuffer> clone() const {
+		return std::make_shared<HeapFrameBuffer>(p, n);
+	};
+
+	virtual ~MappedFrameBuffer() {};
+};
+
+} /* namespace ScanVan */
+
+#endif /* MAPPEDFRAMEBUFFER_HPP_ */
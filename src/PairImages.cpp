@@ -7,212 +7,250 @@
 //============================================================================
 
 #include "PairImages.hpp"
+#include "BayerRemap.hpp"
 
 namespace ScanVan {
 
 PairImages::PairImages() {
-	p_img0 = new Images {};
-	p_img1 = new Images {};
 }
 
-PairImages::PairImages(Images &a, Images &b) {
+PairImages::PairImages(const ImagesRaw &a, const ImagesRaw &b) :
+		imgType { ImgType::RAW }, raw0 { a }, raw1 { b } {
+}
 
-	try {
-		p_img0 = new ImagesRaw { dynamic_cast<ImagesRaw &>(a) };
-	} catch (...) {
-	}
-	try {
-		p_img1 = new ImagesRaw { dynamic_cast<ImagesRaw &>(b) };
-	} catch (...) {
-	}
-	try {
-		p_img0 = new ImagesCV { dynamic_cast<ImagesCV &>(a) };
-	} catch (...) {
-	}
-	try {
-		p_img1 = new ImagesCV { dynamic_cast<ImagesCV &>(b) };
-	} catch (...) {
-	}
+PairImages::PairImages(ImagesRaw &&a, ImagesRaw &&b) :
+		imgType { ImgType::RAW }, raw0 { std::move(a) }, raw1 { std::move(b) } {
+}
 
+PairImages::PairImages(const ImagesRaw &a) :
+		imgType { ImgType::RAW }, raw0 { a } {
 }
 
-PairImages::PairImages(Images &&a, Images &&b) {
+PairImages::PairImages(ImagesRaw &&a) :
+		imgType { ImgType::RAW }, raw0 { std::move(a) } {
+}
 
-	try {
-		p_img0 = new ImagesRaw { std::move(dynamic_cast<ImagesRaw &>(a)) };
-	} catch (...) {
-	}
-	try {
-		p_img1 = new ImagesRaw { std::move(dynamic_cast<ImagesRaw &>(b)) };
-	} catch (...) {
-	}
-	try {
-		p_img0 = new ImagesCV { std::move(dynamic_cast<ImagesCV &>(a)) };
-	} catch (...) {
-	}
-	try {
-		p_img1 = new ImagesCV { std::move(dynamic_cast<ImagesCV &>(b)) };
-	} catch (...) {
-	}
+PairImages::PairImages(const ImagesCV &a, const ImagesCV &b) :
+		imgType { ImgType::CV }, cv0 { a }, cv1 { b } {
+}
 
-//	p_img0 = new ImagesRaw { std::move(a) };
-//	p_img1 = new ImagesRaw { std::move(b) };
+PairImages::PairImages(ImagesCV &&a, ImagesCV &&b) :
+		imgType { ImgType::CV }, cv0 { std::move(a) }, cv1 { std::move(b) } {
 }
 
-PairImages::PairImages(Images &a) {
-	try {
-		p_img0 = new ImagesRaw { dynamic_cast<ImagesRaw &>(a) };
-		p_img1 = new ImagesRaw {};
-	} catch (...) {
-	}
+void PairImages::convertRaw2CV() {
+// Demosaics the raw images. The raw images are released, so their buffers can return to the pool.
 
-	try {
-		p_img0 = new ImagesCV { dynamic_cast<ImagesCV &>(a) };
-		p_img1 = new ImagesCV {};
-	} catch (...) {
+	if (imgType != ImgType::RAW) return;
+
+	if (raw0.getImgBufferSize() != 0) {
+		cv0 = ImagesCV { raw0 };
 	}
+	if (raw1.getImgBufferSize() != 0) {
+		cv1 = ImagesCV { raw1 };
+	}
+	raw0 = ImagesRaw { };
+	raw1 = ImagesRaw { };
 
-//	p_img0 = new ImagesRaw { a };
-//	p_img1 = new ImagesRaw {};
+	imgType = ImgType::CV;
 }
 
-PairImages::PairImages(Images &&a) {
-	try {
-		p_img0 = new ImagesRaw { std::move(dynamic_cast<ImagesRaw &>(a)) };
-		p_img1 = new ImagesRaw { };
-	} catch (...) {
-	}
+void PairImages::convertCV2Equi(const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2) {
 
-	try {
-		p_img0 = new ImagesCV { std::move(dynamic_cast<ImagesCV &>(a)) };
-		p_img1 = new ImagesCV { };
-	} catch (...) {
-	}
+	if (imgType == ImgType::CV) {
+		if (cv0.getImgBufferSize() != 0) {
+			cv0.remap(map_0_1, map_0_2);
+		}
+		if (cv1.getImgBufferSize() != 0) {
+			cv1.remap(map_1_1, map_1_2);
+		}
 
+		imgType = ImgType::EQUI;
+	}
 
-//	p_img0 = new ImagesRaw { std::move(a) };
-//	p_img1 = new ImagesRaw {};
 }
 
-PairImages::PairImages(PairImages &a) {
+void PairImages::convertRaw2Equi(const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2) {
+// Demosaics and remaps the raw images in one pass, without the intermediate RGB images.
+// The maps must be the fixed point maps (CV_16SC2, CV_16UC1). The raw images are released.
 
-	ImagesRaw *p0{};
-	ImagesRaw *p1{};
+	if (imgType != ImgType::RAW) return;
 
-	if ((p0 = dynamic_cast<ImagesRaw *>(a.p_img0))) {
-		p_img0 = new ImagesRaw { *p0 };
+	if (raw0.getImgBufferSize() != 0) {
+		cv0 = ImagesCV { raw0, map_0_1, map_0_2 };
 	}
-	if ((p1 = dynamic_cast<ImagesRaw *>(a.p_img1))) {
-		p_img1 = new ImagesRaw { *p1 };
+	if (raw1.getImgBufferSize() != 0) {
+		cv1 = ImagesCV { raw1, map_1_1, map_1_2 };
 	}
+	raw0 = ImagesRaw { };
+	raw1 = ImagesRaw { };
 
-	ImagesCV *p3{};
-	ImagesCV *p4{};
+	imgType = ImgType::EQUI;
+}
 
-	if ((p3 = dynamic_cast<ImagesCV *>(a.p_img0))) {
-		p_img0 = new ImagesCV { *p3 };
+void PairImages::convertRaw2Equi(RemapEngine &engine, Interpolation interp) {
+// Demosaics and remaps the raw images of both cameras at the same time on the threads of the engine.
+// The raw images are released.
+
+	if (imgType != ImgType::RAW) return;
+
+	cv::Mat m0 { };
+	cv::Mat m1 { };
+	std::vector<RemapEngine::Job> jobs { };
+	if (raw0.getImgBufferSize() != 0) {
+		RemapEngine::Job job { };
+		job.cam = 0;
+		job.bayer = raw0.getData();
+		job.height = static_cast<int>(raw0.getHeight());
+		job.width = static_cast<int>(raw0.getWidth());
+		job.dst = &m0;
+		jobs.push_back(job);
 	}
-	if ((p4 = dynamic_cast<ImagesCV *>(a.p_img1))) {
-		p_img1 = new ImagesCV { *p4 };
+	if (raw1.getImgBufferSize() != 0) {
+		RemapEngine::Job job { };
+		job.cam = 1;
+		job.bayer = raw1.getData();
+		job.height = static_cast<int>(raw1.getHeight());
+		job.width = static_cast<int>(raw1.getWidth());
+		job.dst = &m1;
+		jobs.push_back(job);
 	}
+	engine.run(jobs, interp);
 
-	imgType = a.imgType;
+	if (raw0.getImgBufferSize() != 0) {
+		cv0 = ImagesCV { raw0, m0 };
+	}
+	if (raw1.getImgBufferSize() != 0) {
+		cv1 = ImagesCV { raw1, m1 };
+	}
+	raw0 = ImagesRaw { };
+	raw1 = ImagesRaw { };
 
+	imgType = ImgType::EQUI;
 }
 
-PairImages::PairImages(PairImages &&a) {
+void PairImages::convertCV2Equi(RemapEngine &engine, Interpolation interp) {
+// Remaps the RGB images of both cameras at the same time on the threads of the engine
 
-	/*ImagesRaw *p0{};
-	ImagesRaw *p1{};
+	if (imgType != ImgType::CV) return;
 
-	if ((p0 = dynamic_cast<ImagesRaw *>(a.p_img0))) {
-		p_img0 = new ImagesRaw { *p0 };
+	cv::Mat m0 { };
+	cv::Mat m1 { };
+	std::vector<RemapEngine::Job> jobs { };
+	if (cv0.getImgBufferSize() != 0) {
+		RemapEngine::Job job { };
+		job.cam = 0;
+		job.bgr = cv0.getMat();
+		job.dst = &m0;
+		jobs.push_back(job);
 	}
-	if ((p1 = dynamic_cast<ImagesRaw *>(a.p_img1))) {
-		p_img1 = new ImagesRaw { *p1 };
+	if (cv1.getImgBufferSize() != 0) {
+		RemapEngine::Job job { };
+		job.cam = 1;
+		job.bgr = cv1.getMat();
+		job.dst = &m1;
+		jobs.push_back(job);
 	}
+	engine.run(jobs, interp);
 
-	ImagesCV *p3{};
-	ImagesCV *p4{};
-
-	if ((p3 = dynamic_cast<ImagesCV *>(a.p_img0))) {
-		p_img0 = new ImagesCV { *p3 };
+	if (cv0.getImgBufferSize() != 0) {
+		cv0.setMat(m0);
+	}
+	if (cv1.getImgBufferSize() != 0) {
+		cv1.setMat(m1);
 	}
-	if ((p4 = dynamic_cast<ImagesCV *>(a.p_img1))) {
-		p_img1 = new ImagesCV { *p4 };
-	}*/
-
-	p_img0 = a.p_img0;
-	p_img1 = a.p_img1;
-
-	a.p_img0 = nullptr;
-	a.p_img1 = nullptr;
-
-	imgType = a.imgType;
-}
-
-void PairImages::convertRaw2CV() {
-
-	ImagesRaw *p0 { };
-	ImagesRaw *p1 { };
-
-	if (p_img0->getImgBufferSize() != 0)
-		if ((p0 = dynamic_cast<ImagesRaw *>(p_img0))) {
-			p_img0 = new ImagesCV { *p0 };
-			delete p0;
-		}
-	if (p_img1->getImgBufferSize() != 0)
-		if ((p1 = dynamic_cast<ImagesRaw *>(p_img1))) {
-			p_img1 = new ImagesCV { *p1 };
-			delete p1;
-		}
 
-	imgType = ImgType::CV;
+	imgType = ImgType::EQUI;
 }
 
-void PairImages::convertCV2Equi(const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2) {
-
-	ImagesCV *p0 {};
-	ImagesCV *p1 {};
-
-	if (imgType == ImgType::CV) {
-		if (p_img0->getImgBufferSize() != 0)
-			if ((p0 = dynamic_cast<ImagesCV *>(p_img0))) {
-				p0->remap(map_0_1, map_0_2);
-			}
-		if (p_img1->getImgBufferSize() != 0)
-			if ((p1 = dynamic_cast<ImagesCV *>(p_img1))) {
-				p1->remap(map_1_1, map_1_2);
-			}
+void PairImages::convertRaw2Preview(RemapEngine &engine, size_t firstMap, Interpolation interp) {
+// Half resolution demosaicing of the raw images followed by the remap with the maps firstMap (camera 0)
+// and firstMap + 1 (camera 1) of the engine, which are expected in the coordinates of the half resolution images.
+// The raw images are released.
+
+	if (imgType != ImgType::RAW) return;
+
+	cv::Mat half0 { };
+	cv::Mat half1 { };
+	cv::Mat m0 { };
+	cv::Mat m1 { };
+	std::vector<RemapEngine::Job> jobs { };
+	if (raw0.getImgBufferSize() != 0) {
+		bayerSuperpixel(raw0.getData(), static_cast<int>(raw0.getHeight()), static_cast<int>(raw0.getWidth()), half0);
+		RemapEngine::Job job { };
+		job.cam = firstMap;
+		job.bgr = &half0;
+		job.dst = &m0;
+		jobs.push_back(job);
+	}
+	if (raw1.getImgBufferSize() != 0) {
+		bayerSuperpixel(raw1.getData(), static_cast<int>(raw1.getHeight()), static_cast<int>(raw1.getWidth()), half1);
+		RemapEngine::Job job { };
+		job.cam = firstMap + 1;
+		job.bgr = &half1;
+		job.dst = &m1;
+		jobs.push_back(job);
+	}
+	engine.run(jobs, interp);
 
-		imgType = ImgType::EQUI;
+	if (raw0.getImgBufferSize() != 0) {
+		cv0 = ImagesCV { raw0, m0 };
+	}
+	if (raw1.getImgBufferSize() != 0) {
+		cv1 = ImagesCV { raw1, m1 };
 	}
+	raw0 = ImagesRaw { };
+	raw1 = ImagesRaw { };
 
+	imgType = ImgType::EQUI;
 }
 
 cv::Mat PairImages::rgbConcat(){
-	cv::Mat *i0 = ((ImagesCV*)p_img0)->getMat();
-	cv::Mat *i1 = ((ImagesCV*)p_img1)->getMat();
-	cv::Mat dst(i0->rows, i0->cols*2, CV_8UC3);
-	i0->copyTo(dst.colRange(0, i0->cols));
-	i1->copyTo(dst.colRange(i0->cols, i0->cols*2));
+	const cv::Mat &i0 = *cv0.getMat();
+	const cv::Mat &i1 = *cv1.getMat();
+	cv::Mat dst(i0.rows, i0.cols*2, CV_8UC3);
+	i0.copyTo(dst.colRange(0, i0.cols));
+	i1.copyTo(dst.colRange(i0.cols, i0.cols*2));
 	return dst;
 }
 
 
 
 void PairImages::showPair() {
-	if (p_img0->getImgBufferSize() != 0)
-		p_img0->show(p_img0->getSerialNumber());
-	if (p_img1->getImgBufferSize() != 0)
-		p_img1->show(p_img1->getSerialNumber());
+	switch (imgType) {
+	case ImgType::RAW:
+		if (raw0.getImgBufferSize() != 0)
+			raw0.show(raw0.getSerialNumber());
+		if (raw1.getImgBufferSize() != 0)
+			raw1.show(raw1.getSerialNumber());
+		break;
+	case ImgType::CV:
+	case ImgType::EQUI:
+		if (cv0.getImgBufferSize() != 0)
+			cv0.show(cv0.getSerialNumber());
+		if (cv1.getImgBufferSize() != 0)
+			cv1.show(cv1.getSerialNumber());
+		break;
+	}
 }
 
 void PairImages::showPairConcat() {
-	if (p_img1->getImgBufferSize() != 0) {
-		p_img0->showConcat(p_img0->getSerialNumber() + "_" + p_img1->getSerialNumber(), *p_img1);
-	} else {
-		p_img0->show(p_img0->getSerialNumber());
+	switch (imgType) {
+	case ImgType::RAW:
+		if (raw1.getImgBufferSize() != 0) {
+			raw0.showConcat(raw0.getSerialNumber() + "_" + raw1.getSerialNumber(), raw1);
+		} else {
+			raw0.show(raw0.getSerialNumber());
+		}
+		break;
+	case ImgType::CV:
+	case ImgType::EQUI:
+		if (cv1.getImgBufferSize() != 0) {
+			cv0.showConcat(cv0.getSerialNumber() + "_" + cv1.getSerialNumber(), cv1);
+		} else {
+			cv0.show(cv0.getSerialNumber());
+		}
+		break;
 	}
 }
 
@@ -251,81 +289,150 @@ void PairImages::showUndistortPairConcat (const cv::Mat & map_0_1, const cv::Mat
 }
 */
 
-void PairImages::savePair(std::string path) {
-	if ((imgType == ImgType::RAW) || (imgType == ImgType::CV)) {
-		if (p_img0->getImgBufferSize() != 0) {
-			p_img0->saveData(path);
+void PairImages::savePair(std::string path, const StorageOptions &options) {
+// With a codec the raw images are compressed.
+// With an engine the raw pairs are converted to equirectangular images first, the pair keeps them.
+	if ((imgType == ImgType::RAW) && (options.equirect != nullptr)) {
+		convertRaw2Equi(*options.equirect, options.interp);
+	}
+	switch (imgType) {
+	case ImgType::RAW:
+		if (raw0.getImgBufferSize() != 0) {
+			raw0.saveData(path, options.codec);
+		}
+		if (raw1.getImgBufferSize() != 0) {
+			raw1.saveData(path, options.codec);
 		}
-		if (p_img1->getImgBufferSize() != 0) {
-			p_img1->saveData(path);
+		break;
+	case ImgType::CV:
+		if (cv0.getImgBufferSize() != 0) {
+			cv0.saveData(path, options.encoding);
 		}
-	} else if (imgType == ImgType::EQUI) {
-		(dynamic_cast<ImagesCV *>(p_img0))->saveDataConcat(path, *p_img1);
+		if (cv1.getImgBufferSize() != 0) {
+			cv1.saveData(path, options.encoding);
+		}
+		break;
+	case ImgType::EQUI:
+		cv0.saveDataConcat(path, cv1, options.encoding);
+		break;
 	}
 }
 
-void PairImages::setImgNumber (const long int &n) {
-	if (p_img0->getImgBufferSize() != 0) {
-		p_img0->setImgNumber(n);
+void PairImages::encodePair(const std::string &path, const StorageOptions &options, std::vector<StorageFile> &files) {
+// Prepares the files of savePair without writing them, the conversion to equirectangular images included
+	if ((imgType == ImgType::RAW) && (options.equirect != nullptr)) {
+		convertRaw2Equi(*options.equirect, options.interp);
 	}
-	if (p_img1->getImgBufferSize() != 0) {
-		p_img1->setImgNumber(n);
+	switch (imgType) {
+	case ImgType::RAW:
+		if (raw0.getImgBufferSize() != 0) {
+			raw0.encodeData(path, options.codec, files);
+		}
+		if (raw1.getImgBufferSize() != 0) {
+			raw1.encodeData(path, options.codec, files);
+		}
+		break;
+	case ImgType::CV:
+		if (cv0.getImgBufferSize() != 0) {
+			cv0.encodeData(files, options.encoding);
+		}
+		if (cv1.getImgBufferSize() != 0) {
+			cv1.encodeData(files, options.encoding);
+		}
+		break;
+	case ImgType::EQUI:
+		cv0.encodeDataConcat(cv1, files, options.encoding);
+		break;
 	}
 }
 
-PairImages & PairImages::operator=(const PairImages &a){
-	if (this != &a) {
-
-		delete p_img0;
-		delete p_img1;
-
-		ImagesRaw *p0 { };
-		ImagesRaw *p1 { };
-
-		if ((p0 = dynamic_cast<ImagesRaw *>(a.p_img0))) {
-			p_img0 = new ImagesRaw { *p0 };
-		}
-		if ((p1 = dynamic_cast<ImagesRaw *>(a.p_img1))) {
-			p_img1 = new ImagesRaw { *p1 };
+void PairImages::saveBatch(std::vector<PairImages> &batch, std::string path, const StorageOptions &options) {
+// Saves a batch of pairs in one pass, the directory is opened once for the whole batch.
+// With a pool the pairs are encoded and their images written concurrently by the threads of the pool.
+// The camera data files are then committed in the order of the batch (the order of the image numbers):
+// when the data file of a pair exists, its images are complete, and no pair is committed before an earlier one.
+// With a writer the files are handed to it and written in the background, with the same order of the commits.
+	if (batch.empty()) return;
+
+	ThreadPool *pool = options.pool;
+	AsyncWriter *writer = options.writer;
+	int dirfd = openStorageDirectory(path);
+	std::vector<std::vector<StorageFile>> files(batch.size());
+
+	auto store = [&](size_t i) {
+		batch[i].encodePair(path, options, files[i]);
+		for (auto &f : files[i]) {
+			if (f.commit) continue;
+			if (writer != nullptr) {
+				writer->write(dirfd, std::move(f));
+			} else {
+				f.writeAt(dirfd);
+			}
 		}
+	};
 
-		ImagesCV *p3 { };
-		ImagesCV *p4 { };
-
-		if ((p3 = dynamic_cast<ImagesCV *>(a.p_img0))) {
-			p_img0 = new ImagesCV { *p3 };
+	try {
+		if (pool != nullptr) {
+			pool->parallel_for(batch.size(), store);
+		} else {
+			for (size_t i = 0; i < batch.size(); ++i) {
+				store(i);
+			}
 		}
-		if ((p4 = dynamic_cast<ImagesCV *>(a.p_img1))) {
-			p_img1 = new ImagesCV { *p4 };
+		for (auto &pairFiles : files) {
+			for (auto &f : pairFiles) {
+				if (!f.commit) continue;
+				if (writer != nullptr) {
+					writer->commit(dirfd, std::move(f));
+				} else {
+					f.writeAt(dirfd);
+				}
+			}
 		}
-
+	} catch (...) {
+		close(dirfd);
+		throw;
 	}
-	return *this;
+	close(dirfd);
 }
 
+void PairImages::savePair(SequenceWriter &writer) {
+// Appends the raw pair to the sequence
+	if (imgType != ImgType::RAW) {
+		throw std::runtime_error("Only raw pairs can be stored in a sequence.");
+	}
+	writer.append(raw0, raw1);
+}
 
+void PairImages::saveBatch(std::vector<PairImages> &batch, SequenceWriter &writer) {
+	for (auto &imgs : batch) {
+		imgs.savePair(writer);
+	}
+}
 
+long int PairImages::getImgNumber() const {
+	return (imgType == ImgType::RAW) ? raw0.getImgNumber() : cv0.getImgNumber();
+}
 
-
-PairImages & PairImages::operator=(PairImages &&a){
-	if (this != &a) {
-		delete p_img0;
-		delete p_img1;
-		p_img0 = a.p_img0;
-		p_img1 = a.p_img1;
-		a.p_img0 = nullptr;
-		a.p_img1 = nullptr;
+void PairImages::setImgNumber (const long int &n) {
+	if (imgType == ImgType::RAW) {
+		if (raw0.getImgBufferSize() != 0) {
+			raw0.setImgNumber(n);
+		}
+		if (raw1.getImgBufferSize() != 0) {
+			raw1.setImgNumber(n);
+		}
+	} else {
+		if (cv0.getImgBufferSize() != 0) {
+			cv0.setImgNumber(n);
+		}
+		if (cv1.getImgBufferSize() != 0) {
+			cv1.setImgNumber(n);
+		}
 	}
-	return *this;
 }
 
-
 PairImages::~PairImages() {
-	delete p_img0;
-	delete p_img1;
 }
 
-
-
-
 } /* namespace ScanVan */
@@ -12,35 +12,71 @@
 #include "Images.hpp"
 #include "ImagesRaw.hpp"
 #include "ImagesCV.hpp"
+#include "RemapEngine.hpp"
+#include "SequenceWriter.hpp"
+#include "StorageFile.hpp"
+#include "ThreadPool.hpp"
+#include "AsyncWriter.hpp"
+#include "ImageEncoding.hpp"
+
+#include <vector>
+#include <sys/stat.h>
 
 namespace ScanVan {
 
 enum class ImgType {RAW, CV, EQUI};
 
+// How savePair and saveBatch store the pairs
+struct StorageOptions {
+	BayerCodec *codec = nullptr;					// compresses the raw images (.rawc)
+	ImageEncoding encoding { };						// format of the RGB and the equirectangular images
+	RemapEngine *equirect = nullptr;				// if set, the raw pairs are stored as equirectangular images
+	Interpolation interp = Interpolation::CUBIC;	// of the equirectangular images
+	ThreadPool *pool = nullptr;						// saveBatch: the pairs are converted, encoded and written concurrently
+	AsyncWriter *writer = nullptr;					// saveBatch: the files are written in the background
+};
+
+// The pair holds its images by value. The type tells which of them are valid:
+// raw0 and raw1 for RAW (Bayer), cv0 and cv1 for CV (RGB) and EQUI (equirectangular).
+// The operations dispatch on the type with a switch, without RTTI.
+// An image without pixels (getImgBufferSize() == 0) marks a missing camera.
 class PairImages {
-	Images *p_img0;
-	Images *p_img1;
 	ImgType imgType = ImgType::RAW;
+	ImagesRaw raw0 { };
+	ImagesRaw raw1 { };
+	ImagesCV cv0 { };
+	ImagesCV cv1 { };
 
 public:
 	PairImages();
-	PairImages(Images &a, Images &b);
-	PairImages(Images &&a, Images &&b);
-	PairImages(Images &a);
-	PairImages(Images &&a);
-	PairImages(PairImages &a);
-	PairImages(PairImages &&a);
-	ImgType getType() { return imgType; }
+	PairImages(const ImagesRaw &a, const ImagesRaw &b);
+	PairImages(ImagesRaw &&a, ImagesRaw &&b);
+	PairImages(const ImagesRaw &a);
+	PairImages(ImagesRaw &&a);
+	PairImages(const ImagesCV &a, const ImagesCV &b);
+	PairImages(ImagesCV &&a, ImagesCV &&b);
+	PairImages(const PairImages &a) = default;
+	PairImages(PairImages &&a) = default;
+	ImgType getType() const { return imgType; }
 	void convertRaw2CV();
 	void convertCV2Equi(const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2);
+	void convertRaw2Equi(const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2);
+	void convertRaw2Equi(RemapEngine &engine, Interpolation interp);
+	void convertCV2Equi(RemapEngine &engine, Interpolation interp);
+	void convertRaw2Preview(RemapEngine &engine, size_t firstMap, Interpolation interp);
 	void showPair();
 	void showPairConcat();
 	//void showUndistortPairConcat (const cv::Mat & map_0_1, const cv::Mat & map_0_2, const cv::Mat & map_1_1, const cv::Mat & map_1_2);
-	void savePair(std::string path);
+	void savePair(std::string path, const StorageOptions &options = StorageOptions { });
+	static void saveBatch(std::vector<PairImages> &batch, std::string path, const StorageOptions &options = StorageOptions { });
+	void encodePair(const std::string &path, const StorageOptions &options, std::vector<StorageFile> &files);
+	void savePair(SequenceWriter &writer);
+	static void saveBatch(std::vector<PairImages> &batch, SequenceWriter &writer);
+	long int getImgNumber () const;
 	void setImgNumber (const long int &n);
 	cv::Mat rgbConcat();
-	PairImages & operator=(const PairImages &a);
-	PairImages & operator=(PairImages &&a);
+	PairImages & operator=(const PairImages &a) = default;
+	PairImages & operator=(PairImages &&a) = default;
 	virtual ~PairImages();
 };
 
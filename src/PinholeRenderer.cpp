@@ -0,0 +1,122 @@
+//============================================================================
+// Name        : PinholeRenderer.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Renders pinhole views of the 360 degree equirectangular image.
+//============================================================================
+
+#include "PinholeRenderer.hpp"
+#include "MapRotation.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+namespace ScanVan {
+
+void PinholeRenderer::BuildMap(const PinholeView &view, cv::Size source, cv::Mat &map_1, cv::Mat &map_2) {
+// Same projection as equiToPinhole: the pixel (DX, DY) of the view is the ray (focal, DX - size/2, DY - size/2),
+// rotated by the azimuth and the elevation, and the map gives its position in the equirectangular image
+
+	const int size = view.size;
+	const double focal = 0.5 * size / std::tan(0.5 * view.fov * M_PI / 180.0);
+	const double cosA = std::cos(view.azim);
+	const double sinA = std::sin(view.azim);
+	const double cosE = std::cos(view.elev);
+	const double sinE = std::sin(view.elev);
+	// Rotation matrix of equiToPinhole with a roll of 0
+	const double rot[3][3] = {
+		{ cosA * cosE, -sinA, cosA * sinE },
+		{ sinA * cosE, cosA, sinA * sinE },
+		{ -sinE, 0.0, cosE }
+	};
+
+	map_1.create(size, size, CV_16SC2);
+	map_2.create(size, size, CV_16UC1);
+
+	cv::parallel_for_(cv::Range(0, size), [&](const cv::Range &range) {
+		std::vector<float> sx(size);
+		std::vector<float> sy(size);
+		for (int dy = range.start; dy < range.end; ++dy) {
+			const double py = dy - 0.5 * size;
+			for (int dx = 0; dx < size; ++dx) {
+				const double px = dx - 0.5 * size;
+				double x = rot[0][0] * focal + rot[0][1] * px + rot[0][2] * py;
+				double y = rot[1][0] * focal + rot[1][1] * px + rot[1][2] * py;
+				double z = rot[2][0] * focal + rot[2][1] * px + rot[2][2] * py;
+				double theta = std::atan2(y, x);
+				if (theta < 0) {
+					theta += 2 * M_PI;
+				}
+				double norm = std::sqrt(x * x + y * y + z * z);
+				sx[dx] = static_cast<float>(source.width * theta / (2 * M_PI));
+				sy[dx] = static_cast<float>(source.height * (std::asin(z / norm) / M_PI + 0.5));
+			}
+			toFixedPoint(sx.data(), sy.data(), size, map_1.ptr<int16_t>(dy), map_2.ptr<uint16_t>(dy));
+		}
+	});
+}
+
+const PinholeRenderer::CachedMap & PinholeRenderer::GetMap(const PinholeView &view, cv::Size source) {
+	for (auto it = cache.begin(); it != cache.end(); ++it) {
+		if ((it->view == view) && (it->source == source)) {
+			cache.splice(cache.begin(), cache, it);
+			return cache.front();
+		}
+	}
+
+	CachedMap m { };
+	m.view = view;
+	m.source = source;
+	BuildMap(view, source, m.map_1, m.map_2);
+	cache.push_front(std::move(m));
+	if (cache.size() > maxCachedMaps) {
+		cache.pop_back();
+	}
+	return cache.front();
+}
+
+void PinholeRenderer::render(const cv::Mat &src, const std::vector<PinholeView> &views, std::vector<cv::Mat> &outputs) {
+
+	if (src.type() != CV_8UC3) {
+		throw std::runtime_error("The pinhole views are rendered from a CV_8UC3 image.");
+	}
+	outputs.clear();
+	if (views.empty()) return;
+
+	if ((views != stackedViews) || (src.size() != stackedSource)) {
+		// The maps of the views are stacked vertically, the narrower views are padded
+		int width = 0;
+		int height = 0;
+		for (const auto &v : views) {
+			if (v.size <= 0) {
+				throw std::runtime_error("The size of a pinhole view must be positive.");
+			}
+			width = std::max(width, v.size);
+			height += v.size;
+		}
+		stacked_1 = cv::Mat::zeros(height, width, CV_16SC2);
+		stacked_2 = cv::Mat::zeros(height, width, CV_16UC1);
+		int y = 0;
+		for (const auto &v : views) {
+			const CachedMap &m = GetMap(v, src.size());
+			m.map_1.copyTo(stacked_1(cv::Rect(0, y, v.size, v.size)));
+			m.map_2.copyTo(stacked_2(cv::Rect(0, y, v.size, v.size)));
+			y += v.size;
+		}
+		stackedViews = views;
+		stackedSource = src.size();
+	}
+
+	// The equirectangular image covers 360 degrees, the columns wrap around
+	cv::remap(src, output, stacked_1, stacked_2, cv::INTER_LINEAR, cv::BORDER_WRAP);
+
+	int y = 0;
+	for (const auto &v : views) {
+		outputs.push_back(output(cv::Rect(0, y, v.size, v.size)));
+		y += v.size;
+	}
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,70 @@
+//============================================================================
+// Name        : PinholeRenderer.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Renders pinhole views of the 360 degree equirectangular image.
+//				 The sampling map of a view depends only on its parameters and
+//				 the size of the source, so it is computed once and cached.
+//				 The maps of all the views are stacked and rendered with one
+//				 call to cv::remap (vectorized bilinear interpolation); each
+//				 view is a region of the common output.
+//============================================================================
+
+#ifndef PINHOLERENDERER_HPP_
+#define PINHOLERENDERER_HPP_
+
+#include <vector>
+#include <list>
+
+// Include files to use OpenCV API
+#include <opencv2/opencv.hpp>
+
+namespace ScanVan {
+
+struct PinholeView {
+	float fov = 60;		// horizontal and vertical aperture in degrees
+	float azim = 0;		// azimuth of the centre of the view in radians
+	float elev = 0;		// elevation of the centre of the view in radians
+	int size = 1000;	// the views are square, size x size pixels
+
+	bool operator==(const PinholeView &v) const {
+		return (fov == v.fov) && (azim == v.azim) && (elev == v.elev) && (size == v.size);
+	}
+};
+
+class PinholeRenderer {
+private:
+	struct CachedMap {
+		PinholeView view { };
+		cv::Size source { };
+		cv::Mat map_1 { };	// CV_16SC2
+		cv::Mat map_2 { };	// CV_16UC1
+	};
+
+	static const size_t maxCachedMaps = 16;
+	std::list<CachedMap> cache { };		// most recently used first
+
+	// Stacked maps of the last list of views
+	std::vector<PinholeView> stackedViews { };
+	cv::Size stackedSource { };
+	cv::Mat stacked_1 { };
+	cv::Mat stacked_2 { };
+	cv::Mat output { };
+
+	const CachedMap & GetMap(const PinholeView &view, cv::Size source);
+	static void BuildMap(const PinholeView &view, cv::Size source, cv::Mat &map_1, cv::Mat &map_2);
+
+public:
+	PinholeRenderer() {};
+
+	// Renders the views of the equirectangular image src (CV_8UC3, 360 x 180 degrees).
+	// views[i] is written to outputs[i], a region of a buffer that is reused by the next call.
+	void render(const cv::Mat &src, const std::vector<PinholeView> &views, std::vector<cv::Mat> &outputs);
+
+	size_t getCachedMaps() const { return cache.size(); }
+};
+
+} /* namespace ScanVan */
+
+#endif /* PINHOLERENDERER_HPP_ */
@@ -0,0 +1,457 @@
+//============================================================================
+// Name        : PylonCameraSource.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source of the raw images from the Basler GigE cameras.
+//============================================================================
+
+#ifdef USE_GIGE
+
+#include "PylonCameraSource.hpp"
+#include "PylonFrameBuffer.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+// Settings to use Basler GigE cameras.
+using namespace Basler_GigECameraParams;
+// Namespace for using pylon objects.
+using namespace Pylon;
+// Namespace for using cout.
+using namespace std;
+
+namespace ScanVan {
+
+PylonCameraSource::PylonCameraSource(const CameraSettings &s) : settings { s } {
+}
+
+void PylonCameraSource::Open() {
+
+	CTlFactory& tlFactory = CTlFactory::GetInstance();
+	pTL = dynamic_cast<IGigETransportLayer*>(tlFactory.CreateTl(BaslerGigEDeviceClass));
+	if (pTL == nullptr) {
+		throw RUNTIME_EXCEPTION("No GigE transport layer available.");
+	}
+
+	// In this sample we use the transport layer directly to enumerate cameras.
+	// By calling EnumerateDevices on the TL we get get only GigE cameras.
+	// You could also accomplish this by using a filter and
+	// let the Transport Layer Factory enumerate.
+	DeviceInfoList_t allDeviceInfos { };
+	if (pTL->EnumerateDevices(allDeviceInfos) == 0) {
+		throw RUNTIME_EXCEPTION("No GigE cameras present.");
+	}
+
+	// Only use cameras in the same subnet as the first one.
+	DeviceInfoList_t usableDeviceInfos { };
+	usableDeviceInfos.push_back(allDeviceInfos[0]);
+	subnet = static_cast<const CBaslerGigEDeviceInfo&>(allDeviceInfos[0]).GetSubnetAddress();
+
+	// Start with index 1 as we have already added the first one above.
+	// We will also limit the number of cameras to c_maxCamerasToUse.
+	for (size_t i = 1; i < allDeviceInfos.size() && usableDeviceInfos.size() < c_maxCamerasToUse; ++i) {
+		const CBaslerGigEDeviceInfo& gigeinfo = static_cast<const CBaslerGigEDeviceInfo&>(allDeviceInfos[i]);
+		if (subnet == gigeinfo.GetSubnetAddress()) {
+			// Add this deviceInfo to the ones we will be using.
+			usableDeviceInfos.push_back(gigeinfo);
+		} else {
+			cerr << "Camera will not be used because it is in a different subnet " << subnet << "!" << endl;
+		}
+	}
+
+	// Check if all the cameras have been detected
+	if (usableDeviceInfos.size() > c_maxCamerasToUse) {
+		throw std::runtime_error("More than maxCamerasToUse cameras detected!");
+	}
+	if (usableDeviceInfos.size() > c_maxCamerasToUse) {
+		std::cerr << "Not all the cameras have been detected!" << std::endl;
+	}
+
+	cameras.Initialize(usableDeviceInfos.size());
+
+	// Seed the random number generator and generate a random device key value.
+	srand((unsigned) time(nullptr));
+	DeviceKey = rand();
+
+	// For the following sample we use the CActionTriggerConfiguration to configure the camera.
+	// It will set the DeviceKey, GroupKey and GroupMask features. It will also
+	// configure the camera FrameTrigger and set the TriggerSource to the action command.
+	// You can look at the implementation of CActionTriggerConfiguration in <pylon/gige/ActionTriggerConfiguration.h>
+	// to see which features are set.
+
+	// vector of serial number to sort and order the camera idx
+	struct SerialNumIdx {
+		String_t number;
+		size_t index;
+	};
+	std::vector<SerialNumIdx> sn{};
+
+	// Create all GigE cameras and attach them to the InstantCameras in the array.
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		cameras[i].Attach(tlFactory.CreateDevice(usableDeviceInfos[i]));
+		// We'll use the CActionTriggerConfiguration, which will set up the cameras to wait for an action command.
+		if (settings.useExternalTrigger == false) {
+			cameras[i].RegisterConfiguration(new CActionTriggerConfiguration { DeviceKey, GroupKey, AllGroupMask }, RegistrationMode_Append,
+					Cleanup_Delete);
+		}
+		// Set the context. This will help us later to correlate the grab result to a camera in the array.
+		cameras[i].SetCameraContext(i);
+
+		const CBaslerGigEDeviceInfo& di = cameras[i].GetDeviceInfo();
+
+		// Print the model name of the camera.
+		cout << "Using camera " << i << ": " << di.GetModelName() << " (" << di.GetIpAddress() << ")" << " - (SN:" << di.GetSerialNumber() << ")" << endl;
+
+		SerialNumIdx elem {di.GetSerialNumber(), i};
+		// push the serial numbers and the idx positions into vectors
+		sn.push_back(elem);
+	}
+
+	// Sort the serial numbers in increasing value
+	std::sort(sn.begin(), sn.end(), [](const auto &e1, const auto &e2) {
+		return e1.number < e2.number;
+	});
+
+	// Store the indices of the camera corresponding to the increasing value of serial numbers
+	for (const auto &x : sn) {
+		sortedCameraIdx.push_back(x.index);
+		serialNumbers.push_back(std::string { x.number.c_str() });
+	}
+
+	// Open all cameras.
+	// This will apply the CActionTriggerConfiguration specified above.
+	cameras.Open();
+
+	// Reads the camera parameters from file
+	if (settings.loadParam) {
+		try {
+			LoadParameters();
+		} catch (const GenericException &e) {
+			// Error handling
+			cerr << "Error loading the parameters of the camera." << std::endl;
+			cerr <<  e.GetDescription() << endl;
+		}
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		// This sets the transfer pixel format to BayerRG8
+		cameras[i].PixelFormat.SetValue(PixelFormat_BayerRG8);
+
+		cameras[i].GevSCPSPacketSize.SetValue(8192);
+		//cameras[i].GevSCPSPacketSize.SetValue(9000);
+		cameras[i].GevSCPD.SetValue(3500); // Inter-packet delay
+		//cameras[i].GevSCPD.SetValue(20); // Inter-packet delay
+		//cameras[i].GevSCFTD.SetValue(0); // Frame-transmission delay
+        if (i==0)
+            cameras[i].GevSCFTD.SetValue(0); // Frame-transmission delay
+        else
+            cameras[i].GevSCFTD.SetValue(2000); // Frame-transmission delay
+
+		cameras[i].GevSCBWRA.SetValue(cameras[i].GevSCBWRA.GetMax());
+
+		cameras[i].GainAuto.SetValue(GainAuto_Off);
+		cameras[i].ExposureAuto.SetValue(ExposureAuto_Off);
+
+		cameras[i].ExposureTimeAbs.SetValue(settings.exposureTime);
+		cameras[i].GainRaw.SetValue(settings.gain);
+
+		cameras[i].Width.SetValue(100);
+		cameras[i].Height.SetValue(100);
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		if (i == 0) {
+			if (IsWritable(cameras[sortedCameraIdx[0]].OffsetX)) {
+				cameras[sortedCameraIdx[0]].OffsetX.SetValue(settings.offsetX_0);
+			}
+			if (IsWritable(cameras[sortedCameraIdx[0]].OffsetY)) {
+				cameras[sortedCameraIdx[0]].OffsetY.SetValue(settings.offsetY_0);
+			}
+		} else if (i == 1) {
+			if (IsWritable(cameras[sortedCameraIdx[1]].OffsetX)) {
+				cameras[sortedCameraIdx[1]].OffsetX.SetValue(settings.offsetX_1);
+			}
+
+			if (IsWritable(cameras[sortedCameraIdx[1]].OffsetY)) {
+				cameras[sortedCameraIdx[1]].OffsetY.SetValue(settings.offsetY_1);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+
+		cameras[i].Width.SetValue(settings.width);
+		cameras[i].Height.SetValue(settings.height);
+
+		cameras[i].AutoFunctionAOISelector.SetValue(AutoFunctionAOISelector_AOI1);
+		cameras[i].AutoFunctionAOIWidth.SetValue(settings.aoi_width);
+		cameras[i].AutoFunctionAOIHeight.SetValue(settings.aoi_height);
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		if (i == 0) {
+			cameras[sortedCameraIdx[0]].AutoFunctionAOIOffsetX.SetValue(settings.aoi_offsetX_0);
+			cameras[sortedCameraIdx[0]].AutoFunctionAOIOffsetY.SetValue(settings.aoi_offsetY_0);
+		} else if (i == 1) {
+			cameras[sortedCameraIdx[1]].AutoFunctionAOIOffsetX.SetValue(settings.aoi_offsetX_1);
+			cameras[sortedCameraIdx[1]].AutoFunctionAOIOffsetY.SetValue(settings.aoi_offsetY_1);
+		}
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+
+		cameras[i].AutoTargetValue.SetValue(settings.autoTargetVal);
+
+		// Sets auto adjustments continuous
+		if (settings.autoExpTimeCont)
+			cameras[i].ExposureAuto.SetValue(ExposureAuto_Continuous);
+		if (settings.autoGainCont)
+			cameras[i].GainAuto.SetValue(GainAuto_Continuous);
+	}
+
+	if (settings.useExternalTrigger == true) {
+		// Configuration for external trigger
+		for (size_t i = 0; i < cameras.GetSize(); ++i) {
+			cameras[i].AcquisitionMode.SetValue(AcquisitionMode_Continuous);
+			//cameras[i].TriggerSelector.SetValue(TriggerSelector_AcquisitionStart);
+			cameras[i].TriggerSelector.SetValue(TriggerSelector_FrameStart);
+			cameras[i].TriggerMode.SetValue(TriggerMode_On);
+			cameras[i].TriggerSource.SetValue(TriggerSource_Line1);
+			cameras[i].TriggerActivation.SetValue(TriggerActivation_RisingEdge);
+		}
+	}
+
+	if (settings.useChunkFeatures == true) {
+		// Configuration for chunk features
+		for (size_t i = 0; i < cameras.GetSize(); ++i) {
+
+			// Enable chunks in general.
+	        if (GenApi::IsWritable(cameras[i].ChunkModeActive))
+	        {
+	            cameras[i].ChunkModeActive.SetValue(true);
+	        }
+	        else
+	        {
+	            throw RUNTIME_EXCEPTION( "The camera doesn't support chunk features");
+	        }
+
+	        // Enable time stamp chunks.
+	        cameras[i].ChunkSelector.SetValue(ChunkSelector_Timestamp);
+			cameras[i].ChunkEnable.SetValue(true);
+			cameras[i].ChunkSelector.SetValue(ChunkSelector_ExposureTime);
+			cameras[i].ChunkEnable.SetValue(true);
+			cameras[i].ChunkSelector.SetValue(ChunkSelector_GainAll);
+			cameras[i].ChunkEnable.SetValue(true);
+		}
+	}
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		if (i == 0) {
+			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
+			balanceR_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
+			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
+			balanceG_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
+			cameras[sortedCameraIdx[0]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
+			balanceB_0 = cameras[sortedCameraIdx[0]].BalanceRatioAbs.GetValue();
+		} else if (i == 1) {
+			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Red);
+			balanceR_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
+			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Green);
+			balanceG_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
+			cameras[sortedCameraIdx[1]].BalanceRatioSelector.SetValue(BalanceRatioSelector_Blue);
+			balanceB_1 = cameras[sortedCameraIdx[1]].BalanceRatioAbs.GetValue();
+		}
+	}
+
+
+	if (settings.zeroCopyGrab == true) {
+		// The grabbed images hold on to the stream buffers while they are in the queues,
+		// so the grabbers need as many buffers as the frame pool would have, shared among the cameras.
+		// If they are all in use, the retrieval of the next image times out.
+		const size_t numCameras = std::max<size_t>(1, cameras.GetSize());
+		const size_t numBuffers = (settings.numBuffers + numCameras - 1) / numCameras;
+		for (size_t i = 0; i < cameras.GetSize(); ++i) {
+			cameras[i].MaxNumBuffer.SetValue(numBuffers);
+		}
+	}
+
+	// Starts grabbing for all cameras.
+	// The cameras won't transmit any image data, because they are configured to wait for an action command.
+
+	cameras.StartGrabbing();
+
+}
+
+size_t PylonCameraSource::GetNumCam() const {
+	return serialNumbers.size();
+}
+
+std::string PylonCameraSource::GetSerialNumber(size_t idx) const {
+	return serialNumbers.at(idx);
+}
+
+void PylonCameraSource::Trigger() {
+	//////////////////////////////////////////////////////////////////////
+	// Use an Action Command to Trigger Multiple Cameras at the Same Time.
+	//////////////////////////////////////////////////////////////////////
+
+	try {
+		// Now we issue the action command to all devices in the subnet.
+		// The devices with a matching DeviceKey, GroupKey and valid GroupMask will grab an image.
+		pTL->IssueActionCommand(DeviceKey, GroupKey, AllGroupMask, subnet);
+
+//		cameras[0].WaitForFrameTriggerReady(DefaultTimeout_ms, TimeoutHandling_ThrowException);
+//		cameras[1].WaitForFrameTriggerReady(DefaultTimeout_ms, TimeoutHandling_ThrowException);
+
+	} catch (const GenericException &e) {
+		throw std::runtime_error(e.GetDescription());
+	}
+}
+
+bool PylonCameraSource::Retrieve(ImagesRaw &img0, ImagesRaw &img1) {
+
+	const int DefaultTimeout_ms { 5000 };
+
+	try {
+		// This smart pointer will receive the grab result data.
+		CBaslerGigEGrabResultPtr ptrGrabResult { };
+
+		// Retrieve images from all cameras.
+		for (size_t i = 0; i < cameras.GetSize() && cameras.IsGrabbing(); ++i) {
+
+			int64_t captureTimeCam {};
+			double exposureTime {};
+			int gain {};
+
+			// CInstantCameraArray::RetrieveResult will return grab results in the order they arrive.
+			cameras.RetrieveResult(DefaultTimeout_ms, ptrGrabResult, TimeoutHandling_ThrowException);
+
+			// When the cameras in the array are created the camera context value
+			// is set to the index of the camera in the array.
+			// The camera context is a user-settable value.
+			// This value is attached to each grab result and can be used
+			// to determine the camera that produced the grab result.
+			intptr_t cameraIndex = ptrGrabResult->GetCameraContext();
+
+			// Image grabbed successfully?
+			if (ptrGrabResult->GrabSucceeded()) {
+				// Print the index and the model name of the camera.
+				cout << "Camera " << sortedCameraIdx[cameraIndex] << ": " << cameras[cameraIndex].GetDeviceInfo().GetModelName() << " ("
+						<< cameras[cameraIndex].GetDeviceInfo().GetIpAddress() << ") (SN:" << cameras[cameraIndex].GetDeviceInfo().GetSerialNumber()
+						<< ")" << endl;
+				// You could process the image here by accessing the image buffer.
+				cout << "GrabSucceeded: " << ptrGrabResult->GrabSucceeded() << endl;
+				uint8_t *pImageBuffer = static_cast<uint8_t *>(ptrGrabResult->GetBuffer());
+
+				if (settings.useChunkFeatures == true) {
+					// Check to see if a buffer containing chunk data has been received.
+					if (PayloadType_ChunkData != ptrGrabResult->GetPayloadType()) {
+						throw RUNTIME_EXCEPTION( "Unexpected payload type received.");
+					}
+
+		            // Access the chunk data attached to the result.
+		            // Before accessing the chunk data, you should check to see
+		            // if the chunk is readable. When it is readable, the buffer
+		            // contains the requested chunk data.
+		            if (IsReadable(ptrGrabResult->ChunkTimestamp)) {
+		            	captureTimeCam = ptrGrabResult->ChunkTimestamp.GetValue();
+		                cout << "TimeStamp (Result): " << captureTimeCam << endl;
+		            }
+					if (IsReadable(ptrGrabResult->ChunkExposureTime)) {
+						exposureTime = ptrGrabResult->ChunkExposureTime.GetValue();
+						cout << "ExposureTime (Result): " << exposureTime << endl;
+					}
+					if (IsReadable(ptrGrabResult->ChunkGainAll)) {
+						gain = ptrGrabResult->ChunkGainAll.GetValue();
+						cout << "Gain (Result): " << gain << endl;
+					}
+				}
+
+				// Copy image to the object's buffer
+				ImagesRaw &img = (sortedCameraIdx[cameraIndex] == 0) ? img0 : img1;
+				if (settings.zeroCopyGrab == true) {
+					img.setBuffer(std::make_shared<PylonFrameBuffer>(ptrGrabResult));
+				} else {
+					img.copyBuffer(reinterpret_cast<char *>(pImageBuffer));
+				}
+				img.setCaptureCamTime(captureTimeCam);
+				img.setExposureTime(exposureTime);
+				img.setGain(gain);
+				if (sortedCameraIdx[cameraIndex] == 0) {
+					img.setBalanceR(balanceR_0);
+					img.setBalanceG(balanceG_0);
+					img.setBalanceB(balanceB_0);
+				} else {
+					img.setBalanceR(balanceR_1);
+					img.setBalanceG(balanceG_1);
+					img.setBalanceB(balanceB_1);
+				}
+
+				cout << "Gray value of first pixel: " << static_cast<uint32_t>(pImageBuffer[0]) << endl << endl;
+			} else {
+				// If a buffer has been incompletely grabbed, the network bandwidth is possibly insufficient for transferring
+				// multiple images simultaneously. See note above c_maxCamerasToUse.
+				cout << "Error: " << ptrGrabResult->GetErrorCode() << " " << ptrGrabResult->GetErrorDescription() << endl;
+				throw std::runtime_error ("Buffer was incompletely grabbed.");
+			}
+		}
+
+		// In case you want to trigger again you should wait for the camera
+		// to become trigger-ready before issuing the next action command.
+		// To avoid overtriggering you should call cameras[0].WaitForFrameTriggerReady
+		// (see Grab_UsingGrabLoopThread sample for details).
+
+	} catch (const GenericException &e) {
+		throw std::runtime_error(e.GetDescription());
+	}
+
+	return true;
+}
+
+void PylonCameraSource::SaveParameters(const std::string &path) {
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		std::stringstream ss{};
+		ss << cameras[i].GetDeviceInfo().GetSerialNumber().c_str();
+		ss << ".pfs";
+		std::string filename = path + "/" + ss.str();
+
+		cout << "Saving camera's node map to file..." << endl;
+		// Save the content of the camera's node map into the file.
+		CFeaturePersistence::Save(filename.c_str(), &cameras[i].GetNodeMap());
+	}
+
+}
+
+void PylonCameraSource::LoadParameters() {
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		std::stringstream ss { };
+		ss << cameras[i].GetDeviceInfo().GetSerialNumber().c_str();
+		ss << ".pfs";
+		std::string filename = settings.config_path + "/" + ss.str();
+
+	    std::cout << "Reading file back to camera's node map for camera with SN:"<< cameras[i].GetDeviceInfo().GetSerialNumber() << " ..." << std::endl;
+	    CFeaturePersistence::Load(filename.c_str(), &cameras[i].GetNodeMap(), true );
+	}
+}
+
+PylonCameraSource::~PylonCameraSource() {
+
+	cameras.StopGrabbing();
+
+
+	for (size_t i = 0; i < cameras.GetSize(); ++i) {
+		cameras[i].DeviceReset();
+	}
+
+
+	// Close all cameras.
+	cameras.Close();
+}
+
+} /* namespace ScanVan */
+
+#endif /* USE_GIGE */
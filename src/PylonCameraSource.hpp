@@ -0,0 +1,82 @@
+//============================================================================
+// Name        : PylonCameraSource.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source of the raw images from the Basler GigE cameras.
+//				 The cameras are triggered at the same time with an action
+//				 command, or by the external trigger on line 1.
+//============================================================================
+
+#ifndef PYLONCAMERASOURCE_HPP_
+#define PYLONCAMERASOURCE_HPP_
+
+#ifdef USE_GIGE
+
+// Include files to use the PYLON API.
+#include <pylon/PylonIncludes.h>
+#include <pylon/gige/PylonGigEIncludes.h>
+#include <pylon/gige/ActionTriggerConfiguration.h>
+
+#include <vector>
+
+#include "CameraSource.hpp"
+
+namespace ScanVan {
+
+class PylonCameraSource: public ICameraSource {
+private:
+	CameraSettings settings;
+
+	Pylon::IGigETransportLayer *pTL{};
+	// Limits the amount of cameras used for grabbing.
+	// It is important to manage the available bandwidth when grabbing with multiple
+	// cameras. This applies, for instance, if two GigE cameras are connected to the
+	// same network adapter via a switch. To manage the bandwidth, the GevSCPD
+	// interpacket delay parameter and the GevSCFTD transmission delay parameter can
+	// be set for each GigE camera device. The "Controlling Packet Transmission Timing
+	// with the Interpacket and Frame Transmission Delays on Basler GigE Vision Cameras"
+	// Application Note (AW000649xx000) provides more information about this topic.
+	uint32_t c_maxCamerasToUse = 2;
+	Pylon::CBaslerGigEInstantCameraArray cameras{};
+	uint32_t DeviceKey = 0;
+	// For this sample we configure all cameras to be in the same group.
+	uint32_t GroupKey = 0x112233;
+	Pylon::String_t subnet {};
+
+	std::vector<size_t> sortedCameraIdx {};
+	std::vector<std::string> serialNumbers {};	// in the order of the sorted camera indices
+
+	// White balance settings from cameras
+	// They are read at initialization
+	double balanceR_0 {};
+	double balanceG_0 {};
+	double balanceB_0 {};
+
+	double balanceR_1 { };
+	double balanceG_1 { };
+	double balanceB_1 { };
+
+	void LoadParameters();
+
+public:
+	PylonCameraSource(const CameraSettings &s);
+	PylonCameraSource(const PylonCameraSource &) = delete;
+	PylonCameraSource & operator=(const PylonCameraSource &) = delete;
+
+	void Open();
+	size_t GetNumCam() const;
+	std::string GetSerialNumber(size_t idx) const;
+	void Trigger();
+	bool Retrieve(ImagesRaw &img0, ImagesRaw &img1);
+	bool ProvidesBuffers() const { return settings.zeroCopyGrab; };
+	void SaveParameters(const std::string &path);
+
+	virtual ~PylonCameraSource();
+};
+
+} /* namespace ScanVan */
+
+#endif /* USE_GIGE */
+
+#endif /* PYLONCAMERASOURCE_HPP_ */
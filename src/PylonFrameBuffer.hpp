@@ -0,0 +1,48 @@
+//============================================================================
+// Name        : PylonFrameBuffer.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Frame buffer that keeps the grab result of Pylon alive instead
+//				 of copying the pixels out of it. The stream buffer returns to
+//				 the grabber when the last image that refers to it is destroyed.
+//============================================================================
+
+#ifndef PYLONFRAMEBUFFER_HPP_
+#define PYLONFRAMEBUFFER_HPP_
+
+#include <memory>
+#include <stdint.h>
+
+// Include files to use the PYLON API.
+#include <pylon/PylonIncludes.h>
+#include <pylon/gige/PylonGigEIncludes.h>
+
+#include "FrameBuffer.hpp"
+
+namespace ScanVan {
+
+class PylonFrameBuffer: public FrameBuffer {
+private:
+	// The grab result pointer is reference counted, holding a copy keeps the stream buffer out of the grabber
+	Pylon::CBaslerGigEGrabResultPtr ptrGrabResult;
+public:
+	PylonFrameBuffer(const Pylon::CBaslerGigEGrabResultPtr &ptr) : ptrGrabResult { ptr } {};
+	PylonFrameBuffer(const PylonFrameBuffer &) = delete;
+	PylonFrameBuffer & operator=(const PylonFrameBuffer &) = delete;
+
+	uint8_t * data() { return static_cast<uint8_t *>(ptrGrabResult->GetBuffer()); };
+	const uint8_t * data() const { return static_cast<const uint8_t *>(ptrGrabResult->GetBuffer()); };
+	size_t size() const { return ptrGrabResult->GetImageSize(); };
+
+	// The copy goes to the heap, so that the stream buffer can be given back
+	std::shared_ptr<FrameBuffer> clone() const {
+		return std::make_shared<HeapFrameBuffer>(data(), size());
+	};
+
+	virtual ~PylonFrameBuffer() {};
+};
+
+} /* namespace ScanVan */
+
+#endif /* PYLONFRAMEBUFFER_HPP_ */
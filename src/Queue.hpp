@@ -15,6 +15,8 @@
 #include <queue>
 #include <condition_variable>
 #include <thread>
+#include <vector>
+#include <chrono>
 
 namespace ScanVan {
 
@@ -23,22 +25,52 @@ class thread_safe_queue{
 	std::mutex m;
 	std::condition_variable cv;
 	std::queue<std::shared_ptr<T>> queue;
+	bool closed { false };	// once closed, no element is accepted and the waits return when the queue is empty
 public:
 	thread_safe_queue() {};
 	thread_safe_queue(thread_safe_queue const & other_queue) {};
 
-	void push(T& value) {
+	void push(const T& value) {
+		// It copies the value into the queue
 		std::lock_guard<std::mutex> lg{m};
+		if (closed) return;
 		queue.push(std::make_shared<T>(value));
 		cv.notify_one();
 	}
 
+	void push(T&& value) {
+		// It moves the value into the queue, no copy of the underlying data is made
+		std::shared_ptr<T> p = std::make_shared<T>(std::move(value));
+		std::lock_guard<std::mutex> lg{m};
+		if (closed) return;
+		queue.push(std::move(p));
+		cv.notify_one();
+	}
+
+	void push(std::shared_ptr<T> p) {
+		// It hands over an element that is already owned by a shared pointer
+		std::lock_guard<std::mutex> lg{m};
+		if (closed) return;
+		queue.push(std::move(p));
+		cv.notify_one();
+	}
+
+	template<typename ... Args>
+	void emplace(Args&& ... args) {
+		// It constructs the element in place, outside of the lock
+		std::shared_ptr<T> p = std::make_shared<T>(std::forward<Args>(args)...);
+		std::lock_guard<std::mutex> lg{m};
+		if (closed) return;
+		queue.push(std::move(p));
+		cv.notify_one();
+	}
+
 	std::shared_ptr<T> pop(){
 		std::lock_guard<std::mutex> lg{m};
 		if (queue.empty()){
 			return std::shared_ptr<T>();
 		} else {
-			std::shared_ptr<T> ref(queue.front());
+			std::shared_ptr<T> ref(std::move(queue.front()));
 			queue.pop();
 			return ref;
 		}
@@ -50,12 +82,28 @@ public:
 	}
 
 
+	void close() {
+		// Wakes up all the waiting threads. The elements already in the queue can still be taken.
+		std::lock_guard<std::mutex> lg{m};
+		closed = true;
+		cv.notify_all();
+	}
+
+	bool is_closed() {
+		std::lock_guard<std::mutex> lg{m};
+		return closed;
+	}
+
 	std::shared_ptr<T> wait_pop() {
+		// Returns an empty pointer if the queue is closed and empty
 		std::unique_lock<std::mutex> lg{m};
 		cv.wait(lg, [this] {
-			return !queue.empty();
+			return !queue.empty() || closed;
 		});
-		std::shared_ptr<T> ref = queue.front();
+		if (queue.empty()) {
+			return std::shared_ptr<T>();
+		}
+		std::shared_ptr<T> ref = std::move(queue.front());
 		queue.pop();
 		return ref;
 	}
@@ -71,13 +119,34 @@ public:
 		return queue.size();
 	}
 
-	void wait_pop(T&ref) {
+	bool wait_pop(T&ref) {
+		// The element is moved out of the queue into ref
+		// Returns false if the queue is closed and empty
 		std::unique_lock<std::mutex> lg { m };
 		cv.wait(lg, [this] {
-			return !queue.empty();
+			return !queue.empty() || closed;
 		});
-		ref = queue.front();
+		if (queue.empty()) {
+			return false;
+		}
+		ref = std::move(*queue.front());
 		queue.pop();
+		return true;
+	}
+
+	template<typename Rep, typename Period>
+	bool wait_pop_for(T&ref, const std::chrono::duration<Rep, Period> &timeout) {
+		// Same as wait_pop, but it also returns false if the timeout expires
+		std::unique_lock<std::mutex> lg { m };
+		cv.wait_for(lg, timeout, [this] {
+			return !queue.empty() || closed;
+		});
+		if (queue.empty()) {
+			return false;
+		}
+		ref = std::move(*queue.front());
+		queue.pop();
+		return true;
 	}
 
 	bool pop(T& ref) {
@@ -85,11 +154,39 @@ public:
 		if (queue.empty()) {
 			return false;
 		} else {
-			ref = queue.front();
+			ref = std::move(*queue.front());
 			queue.pop();
 			return true;
 		}
 	}
+
+	template<typename Rep, typename Period>
+	std::vector<std::shared_ptr<T>> wait_pop_batch(size_t max_n, const std::chrono::duration<Rep, Period> &timeout) {
+		// Waits until there is at least one element or the timeout expires,
+		// then takes up to max_n elements with one acquisition of the lock.
+		std::vector<std::shared_ptr<T>> batch { };
+		std::unique_lock<std::mutex> lg { m };
+		cv.wait_for(lg, timeout, [this] {
+			return !queue.empty() || closed;
+		});
+		while ((!queue.empty()) && (batch.size() < max_n)) {
+			batch.push_back(std::move(queue.front()));
+			queue.pop();
+		}
+		return batch;
+	}
+
+	template<typename Container>
+	size_t drain_into(Container &c) {
+		// Moves all the elements currently in the queue at the end of the container
+		std::lock_guard<std::mutex> lg { m };
+		size_t n = queue.size();
+		while (!queue.empty()) {
+			c.push_back(std::move(*queue.front()));
+			queue.pop();
+		}
+		return n;
+	}
 };
 
 } /* namespace ScanVan */
@@ -0,0 +1,309 @@
+//============================================================================
+// Name        : RemapEngine.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Remaps the images of the cameras into the equirectangular
+//				 images, tile by tile on a pool of threads.
+//============================================================================
+
+#include "RemapEngine.hpp"
+#include "BayerRemap.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+
+namespace ScanVan {
+
+Interpolation interpolationFromString(const std::string &name) {
+	if (name == "nearest") return Interpolation::NEAREST;
+	if (name == "linear") return Interpolation::LINEAR;
+	if (name == "cubic") return Interpolation::CUBIC;
+	throw std::runtime_error("Unknown interpolation " + name + ", expected nearest, linear or cubic.");
+}
+
+std::string interpolationToString(Interpolation interp) {
+	switch (interp) {
+	case Interpolation::NEAREST: return "nearest";
+	case Interpolation::LINEAR: return "linear";
+	case Interpolation::CUBIC: return "cubic";
+	}
+	return "";
+}
+
+namespace {
+
+// Coefficients of the bicubic interpolation (same kernel as OpenCV, A = -0.75) for each of the
+// INTER_TAB_SIZE fractional positions, in fixed point with CUBIC_BITS bits
+const int CUBIC_BITS = 11;
+
+struct CubicTable {
+	int c[cv::INTER_TAB_SIZE][4];
+	CubicTable() {
+		const float A = -0.75f;
+		for (int i = 0; i < cv::INTER_TAB_SIZE; ++i) {
+			float x = static_cast<float>(i) / cv::INTER_TAB_SIZE;
+			float w[4];
+			w[0] = ((A * (x + 1) - 5 * A) * (x + 1) + 8 * A) * (x + 1) - 4 * A;
+			w[1] = ((A + 2) * x - (A + 3)) * x * x + 1;
+			w[2] = ((A + 2) * (1 - x) - (A + 3)) * (1 - x) * (1 - x) + 1;
+			w[3] = 1.f - w[0] - w[1] - w[2];
+			int sum = 0;
+			for (int k = 0; k < 4; ++k) {
+				c[i][k] = cvRound(w[k] * (1 << CUBIC_BITS));
+				sum += c[i][k];
+			}
+			// The coefficients sum exactly to one
+			c[i][1] += (1 << CUBIC_BITS) - sum;
+		}
+	}
+};
+
+const CubicTable cubicTable { };
+
+inline uint8_t clampPixel(int v) {
+	return static_cast<uint8_t>((v < 0) ? 0 : ((v > 255) ? 255 : v));
+}
+
+void remapTileBGR(const cv::Mat &src, const int16_t *xy, const uint16_t *frac, int tw, int th,
+		uint8_t *dst, size_t dstStride, Interpolation interp) {
+// Remaps one tile of a CV_8UC3 image, the positions outside of the source are black
+
+	const int rows = src.rows;
+	const int cols = src.cols;
+	const uint8_t *base = src.ptr<uint8_t>(0);
+	const size_t step = src.step;
+	const int tabMask = cv::INTER_TAB_SIZE - 1;
+	const int half = cv::INTER_TAB_SIZE / 2;
+
+	for (int i = 0; i < th; ++i) {
+		uint8_t *pdst = dst + i * dstStride;
+		for (int j = 0; j < tw; ++j) {
+			const int n = i * tw + j;
+			int x = xy[2 * n];
+			int y = xy[2 * n + 1];
+			int f = (frac != nullptr) ? (frac[n] & (cv::INTER_TAB_SIZE * cv::INTER_TAB_SIZE - 1)) : 0;
+			int fx = f & tabMask;
+			int fy = f >> cv::INTER_BITS;
+			uint8_t *out = pdst + 3 * j;
+
+			switch (interp) {
+			case Interpolation::NEAREST: {
+				x += (fx >= half) ? 1 : 0;
+				y += (fy >= half) ? 1 : 0;
+				if ((x >= 0) && (y >= 0) && (x < cols) && (y < rows)) {
+					const uint8_t *p = base + y * step + 3 * x;
+					out[0] = p[0];
+					out[1] = p[1];
+					out[2] = p[2];
+				} else {
+					out[0] = out[1] = out[2] = 0;
+				}
+				break;
+			}
+			case Interpolation::LINEAR: {
+				int weight[4] = { (cv::INTER_TAB_SIZE - fx) * (cv::INTER_TAB_SIZE - fy), fx * (cv::INTER_TAB_SIZE - fy),
+						(cv::INTER_TAB_SIZE - fx) * fy, fx * fy };
+				int acc[3] = { 0, 0, 0 };
+				for (int k = 0; k < 4; ++k) {
+					int sx = x + (k & 1);
+					int sy = y + (k >> 1);
+					if ((weight[k] != 0) && (sx >= 0) && (sy >= 0) && (sx < cols) && (sy < rows)) {
+						const uint8_t *p = base + sy * step + 3 * sx;
+						acc[0] += weight[k] * p[0];
+						acc[1] += weight[k] * p[1];
+						acc[2] += weight[k] * p[2];
+					}
+				}
+				const int shift = 2 * cv::INTER_BITS;
+				for (int c = 0; c < 3; ++c) {
+					out[c] = static_cast<uint8_t>((acc[c] + (1 << (shift - 1))) >> shift);
+				}
+				break;
+			}
+			case Interpolation::CUBIC: {
+				const int *cx = cubicTable.c[fx];
+				const int *cy = cubicTable.c[fy];
+				int acc[3] = { 0, 0, 0 };
+				const bool inside = (x >= 1) && (y >= 1) && (x + 2 < cols) && (y + 2 < rows);
+				for (int r = 0; r < 4; ++r) {
+					int sy = y - 1 + r;
+					if ((!inside) && ((sy < 0) || (sy >= rows))) continue;
+					int row[3] = { 0, 0, 0 };
+					const uint8_t *prow = base + sy * step;
+					for (int c = 0; c < 4; ++c) {
+						int sx = x - 1 + c;
+						if ((!inside) && ((sx < 0) || (sx >= cols))) continue;
+						const uint8_t *p = prow + 3 * sx;
+						row[0] += cx[c] * p[0];
+						row[1] += cx[c] * p[1];
+						row[2] += cx[c] * p[2];
+					}
+					acc[0] += cy[r] * row[0];
+					acc[1] += cy[r] * row[1];
+					acc[2] += cy[r] * row[2];
+				}
+				const int shift = 2 * CUBIC_BITS;
+				for (int c = 0; c < 3; ++c) {
+					out[c] = clampPixel((acc[c] + (1 << (shift - 1))) >> shift);
+				}
+				break;
+			}
+			}
+		}
+	}
+}
+
+} /* namespace */
+
+RemapEngine::RemapEngine(size_t numThreads, int tileSize) :
+		pool { (numThreads == 0) ? std::max<size_t>(1, std::thread::hardware_concurrency()) : numThreads }, tileSize { tileSize } {
+	if (tileSize < 1) {
+		throw std::runtime_error("The size of the remap tiles must be positive.");
+	}
+}
+
+void RemapEngine::setMaps(size_t cam, const cv::Mat &map_1, const cv::Mat &map_2) {
+// Copies the maps into tiles of tileSize x tileSize pixels of the output
+
+	if (map_1.type() != CV_16SC2) {
+		throw std::runtime_error("The remap engine needs the maps converted with cv::convertMaps to CV_16SC2.");
+	}
+	const bool hasFrac = !map_2.empty();
+	if (hasFrac && ((map_2.type() != CV_16UC1) || (map_2.size() != map_1.size()))) {
+		throw std::runtime_error("The remap engine needs the second map of type CV_16UC1 and of the size of the first one.");
+	}
+
+	if (maps.size() <= cam) {
+		maps.resize(cam + 1);
+	}
+	CameraMap &cm = maps[cam];
+	cm.rows = map_1.rows;
+	cm.cols = map_1.cols;
+	cm.tiles.clear();
+
+	for (int ty = 0; ty < map_1.rows; ty += tileSize) {
+		for (int tx = 0; tx < map_1.cols; tx += tileSize) {
+			Tile t { };
+			t.x = tx;
+			t.y = ty;
+			t.w = std::min(tileSize, map_1.cols - tx);
+			t.h = std::min(tileSize, map_1.rows - ty);
+			t.xy.resize(2 * t.w * t.h);
+			if (hasFrac) {
+				t.frac.resize(t.w * t.h);
+			}
+			for (int i = 0; i < t.h; ++i) {
+				const int16_t *pxy = map_1.ptr<int16_t>(ty + i) + 2 * tx;
+				std::copy(pxy, pxy + 2 * t.w, t.xy.begin() + 2 * i * t.w);
+				if (hasFrac) {
+					const uint16_t *pfrac = map_2.ptr<uint16_t>(ty + i) + tx;
+					std::copy(pfrac, pfrac + t.w, t.frac.begin() + i * t.w);
+				}
+			}
+			cm.tiles.push_back(std::move(t));
+		}
+	}
+}
+
+void RemapEngine::setRotation(size_t cam, const cv::Mat &mapX, const cv::Mat &mapY, float alpha) {
+	if (!hasMaps(cam)) {
+		throw std::runtime_error("The remap engine has no map for the camera.");
+	}
+	CameraMap &cm = maps[cam];
+	if (alpha == 0) {
+		cm.rotation.reset();
+		cm.mapXf = cv::Mat { };
+		cm.mapYf = cv::Mat { };
+		return;
+	}
+	if ((mapX.type() != CV_32FC1) || (mapY.type() != CV_32FC1) || (mapX.rows != cm.rows) || (mapX.cols != cm.cols) || (mapY.size() != mapX.size())) {
+		throw std::runtime_error("The rotation needs the float maps (CV_32FC1) of the size of the stored maps.");
+	}
+	cm.mapXf = mapX;
+	cm.mapYf = mapY;
+	cm.rotation = std::make_shared<MapRotation>(cm.rows, cm.cols, alpha);
+}
+
+void RemapEngine::run(std::vector<Job> &jobs, Interpolation interp) {
+
+	// One work item per tile of every job, so the cameras are remapped at the same time
+	std::vector<std::pair<size_t, size_t>> items { };
+	for (size_t k = 0; k < jobs.size(); ++k) {
+		Job &job = jobs[k];
+		if (!hasMaps(job.cam)) {
+			throw std::runtime_error("The remap engine has no map for the camera.");
+		}
+		if ((job.bayer == nullptr) && ((job.bgr == nullptr) || (job.bgr->type() != CV_8UC3))) {
+			throw std::runtime_error("The remap engine needs a BayerRG8 or a CV_8UC3 source.");
+		}
+		const CameraMap &cm = maps[job.cam];
+		job.dst->create(cm.rows, cm.cols, CV_8UC3);
+		for (size_t t = 0; t < cm.tiles.size(); ++t) {
+			items.emplace_back(k, t);
+		}
+	}
+
+	// The bicubic interpolation reads 4 x 4 pixels, the Bayer sources are demosaiced before, in bands of rows
+	std::vector<cv::Mat> demosaiced(jobs.size());
+	if (interp == Interpolation::CUBIC) {
+		const int band = tileSize;
+		std::vector<std::pair<size_t, int>> bands { };
+		for (size_t k = 0; k < jobs.size(); ++k) {
+			const Job &job = jobs[k];
+			if (job.bayer == nullptr) continue;
+			demosaiced[k].create(job.height, job.width, CV_8UC3);
+			for (int r = 0; r < job.height; r += band) {
+				bands.emplace_back(k, r);
+			}
+		}
+		pool.parallel_for(bands.size(), [&](size_t n) {
+			const Job &job = jobs[bands[n].first];
+			cv::Mat &bgr = demosaiced[bands[n].first];
+			const int r = bands[n].second;
+			bayerDemosaicRows(job.bayer, job.height, job.width, bgr.ptr<uint8_t>(0), bgr.step, r, std::min(r + band, job.height));
+		});
+	}
+
+	pool.parallel_for(items.size(), [&](size_t n) {
+		const Job &job = jobs[items[n].first];
+		const cv::Mat &source = demosaiced[items[n].first];
+		const CameraMap &cm = maps[job.cam];
+		const Tile &t = cm.tiles[items[n].second];
+		const int16_t *xy = t.xy.data();
+		const uint16_t *frac = t.frac.empty() ? nullptr : t.frac.data();
+
+		if (cm.rotation) {
+			// The map of the tile is computed from the float maps and the rotation
+			thread_local std::vector<float> rowX { };
+			thread_local std::vector<float> rowY { };
+			thread_local std::vector<int16_t> rotXY { };
+			thread_local std::vector<uint16_t> rotFrac { };
+			rowX.resize(t.w);
+			rowY.resize(t.w);
+			rotXY.resize(2 * t.w * t.h);
+			rotFrac.resize(t.w * t.h);
+			for (int i = 0; i < t.h; ++i) {
+				cm.rotation->sampleRow(cm.mapXf, cm.mapYf, t.y + i, t.x, t.w, rowX.data(), rowY.data());
+				toFixedPoint(rowX.data(), rowY.data(), t.w, rotXY.data() + 2 * i * t.w, rotFrac.data() + i * t.w);
+			}
+			xy = rotXY.data();
+			frac = rotFrac.data();
+		}
+		uint8_t *dst = job.dst->ptr<uint8_t>(t.y) + 3 * t.x;
+		const size_t dstStride = job.dst->step;
+
+		if (!source.empty()) {
+			remapTileBGR(source, xy, frac, t.w, t.h, dst, dstStride, interp);
+		} else if (job.bayer != nullptr) {
+			// Nearest takes the pixel at the rounded position like the BGR path, linear interpolates the four pixels
+			bayerRemapRows(job.bayer, job.height, job.width, xy, 2 * t.w, frac, t.w, dst, dstStride, t.w, 0, t.h,
+					interp == Interpolation::NEAREST);
+		} else {
+			remapTileBGR(*job.bgr, xy, frac, t.w, t.h, dst, dstStride, interp);
+		}
+	});
+}
+
+} /* namespace ScanVan */
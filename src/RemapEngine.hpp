@@ -0,0 +1,97 @@
+//============================================================================
+// Name        : RemapEngine.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Remaps the images of the cameras into the equirectangular
+//				 images. The output is split into square tiles and the map of
+//				 each tile is stored contiguously, so a tile reads its map, its
+//				 part of the source and writes its output while they stay in
+//				 the cache. The tiles of all the cameras of a pair are spread
+//				 over one pool of threads.
+//============================================================================
+
+#ifndef REMAPENGINE_HPP_
+#define REMAPENGINE_HPP_
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdint.h>
+
+// Include files to use OpenCV API
+#include <opencv2/opencv.hpp>
+
+#include "ThreadPool.hpp"
+#include "MapRotation.hpp"
+
+namespace ScanVan {
+
+enum class Interpolation { NEAREST, LINEAR, CUBIC };
+
+// "nearest", "linear" or "cubic"
+Interpolation interpolationFromString(const std::string &name);
+std::string interpolationToString(Interpolation interp);
+
+class RemapEngine {
+private:
+	struct Tile {
+		int x = 0;		// position of the tile in the output
+		int y = 0;
+		int w = 0;		// size of the tile
+		int h = 0;
+		std::vector<int16_t> xy { };		// integer source positions, row after row of the tile
+		std::vector<uint16_t> frac { };		// fractional parts, empty if the map has none
+	};
+
+	struct CameraMap {
+		int rows = 0;
+		int cols = 0;
+		std::vector<Tile> tiles { };
+		// With a rotation the tiles only give the geometry, their map is computed from the float maps at each run
+		std::shared_ptr<const MapRotation> rotation { };
+		cv::Mat mapXf { };
+		cv::Mat mapYf { };
+	};
+
+	ThreadPool pool;
+	int tileSize;
+	std::vector<CameraMap> maps { };
+
+public:
+	// One image to remap, its source is either a BayerRG8 mosaic or a BGR matrix
+	struct Job {
+		size_t cam = 0;						// index of the map
+		const uint8_t *bayer = nullptr;		// BayerRG8 source
+		int height = 0;
+		int width = 0;
+		const cv::Mat *bgr = nullptr;		// CV_8UC3 source, used when bayer is nullptr
+		cv::Mat *dst = nullptr;				// output, allocated by run
+	};
+
+	// numThreads = 0 uses one thread per core
+	RemapEngine(size_t numThreads, int tileSize = 64);
+
+	RemapEngine(const RemapEngine &) = delete;
+	RemapEngine & operator=(const RemapEngine &) = delete;
+
+	// Stores the fixed point maps given by cv::convertMaps (CV_16SC2 and CV_16UC1 or empty) of the camera cam
+	void setMaps(size_t cam, const cv::Mat &map_1, const cv::Mat &map_2);
+	bool hasMaps(size_t cam) const { return (cam < maps.size()) && !maps[cam].tiles.empty(); }
+
+	// Composes the rotation by alpha around the x axis (see MapRotation) into the lookup of the camera cam.
+	// mapX and mapY are the float maps before the rotation, of the size of the maps given to setMaps.
+	// The map is rotated tile by tile during run instead of being rebuilt; alpha = 0 returns to the stored map.
+	void setRotation(size_t cam, const cv::Mat &mapX, const cv::Mat &mapY, float alpha);
+
+	// Remaps all the jobs and returns when they are done.
+	// The Bayer sources are demosaiced on the fly (see BayerRemap.hpp) for NEAREST and LINEAR. CUBIC needs the
+	// 4 x 4 pixels around each position, their Bayer sources are demosaiced in full first (one BGR image per job).
+	void run(std::vector<Job> &jobs, Interpolation interp);
+
+	size_t getNumThreads() const { return pool.size(); }
+};
+
+} /* namespace ScanVan */
+
+#endif /* REMAPENGINE_HPP_ */
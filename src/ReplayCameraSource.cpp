@@ -0,0 +1,249 @@
+//============================================================================
+// Name        : ReplayCameraSource.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source that plays back a recorded sequence of raw images.
+//============================================================================
+
+#include "ReplayCameraSource.hpp"
+
+#include <set>
+#include <algorithm>
+#include <iterator>
+#include <cstdio>
+#include <stdexcept>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace ScanVan {
+
+static std::string rawFileName(size_t idx, long int n) {
+	std::stringstream ss { };
+	ss << idx << "_" << n << ".raw";
+	return ss.str();
+}
+
+static std::string dataFileName(size_t idx, long int n) {
+	std::stringstream ss { };
+	ss << "img_" << idx << "_" << n << ".txt";
+	return ss.str();
+}
+
+static bool fileExists(const std::string &path) {
+	struct stat st { };
+	return stat(path.c_str(), &st) == 0;
+}
+
+ReplayCameraSource::ReplayCameraSource(const CameraSettings &s) : settings { s } {
+	if ((!settings.replay_path.empty()) && (settings.replay_path.back() != '/')) {
+		settings.replay_path += "/";
+	}
+}
+
+void ReplayCameraSource::OpenSequences(const std::vector<std::string> &names) {
+// The cameras and the size of the images are those of the first sequence
+
+	for (const std::string &name : names) {
+		std::unique_ptr<SequenceReader> reader { new SequenceReader { name } };
+		if ((reader->GetHeight() != settings.height) || (reader->GetWidth() != settings.width)) {
+			throw std::runtime_error("The size of the images of the sequence " + name + " does not match the configured height and width.");
+		}
+		if (sequences.empty()) {
+			for (size_t i = 0; i < reader->GetNumCam(); ++i) {
+				serialNumbers.push_back(reader->GetSerialNumber(i));
+				std::cout << "Replaying camera " << i << " (SN:" << serialNumbers.back() << ")" << std::endl;
+			}
+		} else if (reader->GetNumCam() != serialNumbers.size()) {
+			std::cerr << "The sequence " << name << " has another number of cameras, it is skipped." << std::endl;
+			continue;
+		}
+		if (reader->size() > 0) {
+			sequenceStart.push_back(GetNumPairs());
+			sequences.push_back(std::move(reader));
+		}
+	}
+	if (sequences.empty()) {
+		throw std::runtime_error("No recorded images found in " + settings.replay_path);
+	}
+	std::cout << "Replaying " << sequences.size() << " sequences from " << settings.replay_path << std::endl;
+}
+
+void ReplayCameraSource::Open() {
+// Lists the raw files of the directory and keeps the image numbers recorded by both cameras
+// If the directory holds sequences, they are played instead
+
+	std::vector<std::string> names = SequenceReader::List(settings.replay_path);
+	if (!names.empty()) {
+		OpenSequences(names);
+		return;
+	}
+
+	DIR *dir = opendir(settings.replay_path.c_str());
+	if (dir == nullptr) {
+		throw std::runtime_error("Could not open the replay directory " + settings.replay_path);
+	}
+
+	std::set<long int> numbers[2] { };
+	while (struct dirent *entry = readdir(dir)) {
+		std::string name { entry->d_name };
+		size_t idx { };
+		long int n { };
+		char tail { };
+		// The name is accepted only if it reads back identical, e.g. 0_12.raw or the compressed 0_12.rawc
+		if ((sscanf(name.c_str(), "%zu_%ld.ra%c", &idx, &n, &tail) == 3) && (idx < 2)
+				&& ((name == rawFileName(idx, n)) || (name == rawFileName(idx, n) + "c"))) {
+			numbers[idx].insert(n);
+		}
+	}
+	closedir(dir);
+
+	size_t numCam = (numbers[1].empty()) ? 1 : 2;
+	if (numCam == 1) {
+		imageNumbers.assign(numbers[0].begin(), numbers[0].end());
+	} else {
+		std::set_intersection(numbers[0].begin(), numbers[0].end(), numbers[1].begin(), numbers[1].end(), std::back_inserter(imageNumbers));
+	}
+	if (imageNumbers.empty()) {
+		throw std::runtime_error("No recorded images found in " + settings.replay_path);
+	}
+
+	// The serial numbers are taken from the camera data of the first image
+	for (size_t i = 0; i < numCam; ++i) {
+		std::string path_data = settings.replay_path + dataFileName(i, imageNumbers.front());
+		std::string sn { };
+		if (fileExists(path_data)) {
+			ImagesRaw img { };
+			img.parseCameraData(path_data);
+			sn = img.getSerialNumber();
+		}
+		if (sn.empty()) {
+			std::stringstream ss { };
+			ss << "REPLAY" << i;
+			sn = ss.str();
+		}
+		serialNumbers.push_back(sn);
+		std::cout << "Replaying camera " << i << " (SN:" << sn << ")" << std::endl;
+	}
+
+	// The capture times name the images of the conversion, they are read once here
+	captureTimes.reserve(imageNumbers.size());
+	for (long int n : imageNumbers) {
+		std::string path_data = settings.replay_path + dataFileName(0, n);
+		ImagesRaw img { };
+		if (fileExists(path_data)) {
+			img.parseCameraData(path_data);
+		}
+		captureTimes.push_back(img.getCaptureCPUTime());
+	}
+
+	std::cout << "Replaying " << imageNumbers.size() << " images from " << settings.replay_path << std::endl;
+}
+
+void ReplayCameraSource::Load(ImagesRaw &img, size_t idx, long int n) const {
+// Reads the raw image into the buffer of the object and its camera data, if present
+
+	if (img.getImgBufferSize() == 0) {
+		img.setHeight(settings.height);
+		img.setWidth(settings.width);
+	}
+	std::string path_raw = settings.replay_path + rawFileName(idx, n);
+	size_t size = img.getHeight() * img.getWidth();
+	if (!fileExists(path_raw) && fileExists(path_raw + "c")) {
+		// Compressed image, it is decoded into the buffer of the object
+		path_raw += "c";
+		std::ifstream myFile(path_raw, std::ios::in | std::ios::binary);
+		std::vector<uint8_t> coded((std::istreambuf_iterator<char>(myFile)), std::istreambuf_iterator<char>());
+		if (img.getImgBufferSize() == 0) {
+			img.setBuffer(std::make_shared<HeapFrameBuffer>(size));
+		}
+		BayerCodec::shared().decode(coded.data(), coded.size(), img.getBufferP(), img.getHeight(), img.getWidth());
+	} else {
+		std::ifstream myFile(path_raw, std::ios::in | std::ios::binary);
+		if (!myFile) {
+			throw std::runtime_error("Could not open the recorded image " + path_raw);
+		}
+
+		myFile.seekg(0, myFile.end);
+		if (static_cast<size_t>(myFile.tellg()) != size) {
+			throw std::runtime_error("The size of the recorded image " + path_raw + " does not match the configured height and width.");
+		}
+		myFile.seekg(0, myFile.beg);
+
+		if (img.getImgBufferSize() == 0) {
+			img.setBuffer(std::make_shared<HeapFrameBuffer>(size));
+		}
+		myFile.read(reinterpret_cast<char *>(img.getBufferP()), size);
+		myFile.close();
+	}
+
+	std::string path_data = settings.replay_path + dataFileName(idx, n);
+	if (fileExists(path_data)) {
+		img.parseCameraData(path_data);
+	}
+	img.setCameraIdx(idx);
+}
+
+size_t ReplayCameraSource::GetNumPairs() const {
+	if (!sequences.empty()) {
+		return sequenceStart.back() + sequences.back()->size();
+	}
+	return imageNumbers.size();
+}
+
+void ReplayCameraSource::Locate(size_t pos, size_t &seq, size_t &local) const {
+// Sequence of the position and position in the sequence
+	seq = static_cast<size_t>(std::upper_bound(sequenceStart.begin(), sequenceStart.end(), pos) - sequenceStart.begin()) - 1;
+	local = pos - sequenceStart[seq];
+}
+
+void ReplayCameraSource::Read(size_t pos, ImagesRaw &img0, ImagesRaw &img1) const {
+
+	if (pos >= GetNumPairs()) {
+		throw std::out_of_range("The position is after the end of the recording.");
+	}
+	if (!sequences.empty()) {
+		// The images point into the mapped sequence
+		size_t seq { };
+		size_t local { };
+		Locate(pos, seq, local);
+		sequences[seq]->Read(local, img0, img1);
+		img0.setCameraIdx(0);
+		if (serialNumbers.size() == 2) {
+			img1.setCameraIdx(1);
+		}
+		return;
+	}
+
+	Load(img0, 0, imageNumbers[pos]);
+	if (serialNumbers.size() == 2) {
+		Load(img1, 1, imageNumbers[pos]);
+	}
+}
+
+int64_t ReplayCameraSource::GetCaptureTime(size_t pos) const {
+
+	if (pos >= GetNumPairs()) {
+		throw std::out_of_range("The position is after the end of the recording.");
+	}
+	if (!sequences.empty()) {
+		size_t seq { };
+		size_t local { };
+		Locate(pos, seq, local);
+		return sequences[seq]->GetEntry(local).captureTimeCPU;
+	}
+
+	return captureTimes[pos];
+}
+
+bool ReplayCameraSource::Retrieve(ImagesRaw &img0, ImagesRaw &img1) {
+	if (next >= GetNumPairs()) {
+		// End of the recording
+		return false;
+	}
+	Read(next, img0, img1);
+	++next;
+	return true;
+}
+
+} /* namespace ScanVan */
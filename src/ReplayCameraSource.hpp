@@ -0,0 +1,68 @@
+//============================================================================
+// Name        : ReplayCameraSource.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source that plays back a sequence recorded by the storage,
+//				 the files <camera index>_<image number>.raw with their camera
+//				 data img_<camera index>_<image number>.txt, or the sequences
+//				 of the directory (see SequenceReader), whose images are given
+//				 without copying them. One pair is delivered per trigger, so
+//				 the rate is the trigger rate. The pairs can also be read at
+//				 any position, from several threads at once (see Read).
+//============================================================================
+
+#ifndef REPLAYCAMERASOURCE_HPP_
+#define REPLAYCAMERASOURCE_HPP_
+
+#include <vector>
+#include <memory>
+
+#include "CameraSource.hpp"
+#include "SequenceReader.hpp"
+
+namespace ScanVan {
+
+class ReplayCameraSource: public ICameraSource {
+private:
+	CameraSettings settings;
+	std::vector<std::string> serialNumbers {};
+
+	std::vector<long int> imageNumbers {};	// recorded image numbers in increasing order
+	std::vector<int64_t> captureTimes {};	// capture time of the CPU of each image number (camera 0), read once
+	size_t next { 0 };						// position of the next pair to deliver
+
+	// When the directory holds sequences they are played one after the other
+	std::vector<std::unique_ptr<SequenceReader>> sequences {};
+	std::vector<size_t> sequenceStart {};	// position of the first pair of each sequence
+
+	void Load(ImagesRaw &img, size_t idx, long int n) const;
+	void Locate(size_t pos, size_t &seq, size_t &local) const;
+	void OpenSequences(const std::vector<std::string> &names);
+
+public:
+	ReplayCameraSource(const CameraSettings &s);
+
+	void Open();
+	size_t GetNumCam() const { return serialNumbers.size(); };
+	std::string GetSerialNumber(size_t idx) const { return serialNumbers.at(idx); };
+	void Trigger() {};
+	bool Retrieve(ImagesRaw &img0, ImagesRaw &img1);
+	bool ProvidesBuffers() const { return !sequences.empty(); };
+
+	// Number of pairs recorded, once opened
+	size_t GetNumPairs() const;
+
+	// Reads the pair at the position pos, it does not change the position of Retrieve.
+	// The images without buffer get one of the recorded size.
+	void Read(size_t pos, ImagesRaw &img0, ImagesRaw &img1) const;
+
+	// Capture time of the CPU of the pair at the position pos (camera 0), without reading the images
+	int64_t GetCaptureTime(size_t pos) const;
+
+	virtual ~ReplayCameraSource() {};
+};
+
+} /* namespace ScanVan */
+
+#endif /* REPLAYCAMERASOURCE_HPP_ */
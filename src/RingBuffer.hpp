@@ -0,0 +1,259 @@
+//============================================================================
+// Name        : RingBuffer.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Bounded single-producer/single-consumer ring buffer used to
+//				 hand over frames between the pipeline stages.
+//				 The slots are preallocated, so a hand-off costs neither a mutex
+//				 nor a heap allocation. When the buffer is full the selected
+//				 overflow policy decides whether the producer blocks, the oldest
+//				 element is dropped or the new element is dropped.
+//============================================================================
+
+#ifndef RINGBUFFER_HPP_
+#define RINGBUFFER_HPP_
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <stdexcept>
+#include <chrono>
+
+namespace ScanVan {
+
+enum class OverflowPolicy {BLOCK, DROP_OLDEST, DROP_NEWEST};
+
+// Size of a cache line, used to keep the indices of producer and consumer apart
+constexpr size_t cache_line_size = 64;
+
+template<typename T>
+class spsc_ring_buffer {
+	static constexpr size_t not_reading = static_cast<size_t>(-1);
+
+	// Indices run freely, the slot is obtained with the modulo of the number of slots.
+	// There is one slot more than the capacity: with DROP_OLDEST the producer may
+	// overwrite an element while the consumer is still moving out the previous one.
+	alignas(cache_line_size) std::atomic<size_t> head { 0 };		// next slot to write, owned by the producer
+	alignas(cache_line_size) std::atomic<size_t> tail { 0 };		// next slot to read, advanced by the consumer or by a drop
+	alignas(cache_line_size) std::atomic<size_t> reading { not_reading };	// element the consumer is moving out
+	alignas(cache_line_size) std::atomic<size_t> dropped { 0 };	// number of elements discarded by the overflow policy
+	std::atomic<int> waiters { 0 };
+	std::atomic<bool> closed { false };	// once closed, no element is accepted and the waits return when the buffer is empty
+
+	size_t cap;
+	OverflowPolicy policy;
+	std::vector<T> slots;
+
+	// Only used to put a thread to sleep when the buffer is empty or full
+	std::mutex m;
+	std::condition_variable cv;
+
+	void notify() {
+		// The lock is only taken if there is somebody waiting
+		if (waiters.load() > 0) {
+			std::lock_guard<std::mutex> lg { m };
+			cv.notify_all();
+		}
+	}
+
+	template<typename Predicate>
+	void wait(Predicate pred) {
+		if (pred()) return;
+		std::unique_lock<std::mutex> lg { m };
+		++waiters;
+		cv.wait(lg, pred);
+		--waiters;
+	}
+
+	template<typename Predicate, typename Rep, typename Period>
+	bool wait_for(Predicate pred, const std::chrono::duration<Rep, Period> &timeout) {
+		if (pred()) return true;
+		std::unique_lock<std::mutex> lg { m };
+		++waiters;
+		bool res = cv.wait_for(lg, timeout, pred);
+		--waiters;
+		return res;
+	}
+
+	bool full() const {
+		return head.load(std::memory_order_relaxed) - tail.load() >= cap;
+	}
+
+	template<typename U>
+	bool put(U &&value) {
+		size_t h = head.load(std::memory_order_relaxed);
+		if (closed.load()) {
+			return false;
+		}
+		if (full()) {
+			if (policy == OverflowPolicy::DROP_NEWEST) {
+				++dropped;
+				return false;
+			} else if (policy == OverflowPolicy::DROP_OLDEST) {
+				size_t t = tail.load(std::memory_order_acquire);
+				// If the exchange fails the consumer took the element in the meantime
+				if ((h - t >= cap) && tail.compare_exchange_strong(t, t + 1)) {
+					++dropped;
+				}
+			} else {
+				wait([this] {return !full() || closed.load();});
+				if (closed.load()) {
+					return false;
+				}
+			}
+		}
+		// Wait until the consumer finished moving out the slot we are going to write
+		while ((h >= slots.size()) && (reading.load() == h - slots.size())) {
+			std::this_thread::yield();
+		}
+		slots[h % slots.size()] = std::forward<U>(value);
+		head.store(h + 1);
+		notify();
+		return true;
+	}
+
+public:
+	spsc_ring_buffer(size_t capacity, OverflowPolicy p = OverflowPolicy::BLOCK) :
+			cap { capacity }, policy { p }, slots(capacity + 1) {
+		if (capacity == 0) {
+			throw std::invalid_argument("The capacity of the ring buffer must be at least 1.");
+		}
+	}
+	spsc_ring_buffer(spsc_ring_buffer const & other) = delete;
+	spsc_ring_buffer & operator=(spsc_ring_buffer const & other) = delete;
+
+	// Returns false if the element was discarded (with DROP_NEWEST or after close)
+	bool push(const T& value) {
+		return put(value);
+	}
+
+	bool push(T&& value) {
+		// The element is moved into the slot, no copy of the underlying data is made
+		return put(std::move(value));
+	}
+
+	template<typename ... Args>
+	bool emplace(Args&& ... args) {
+		return put(T(std::forward<Args>(args)...));
+	}
+
+	bool pop(T& ref) {
+		size_t t = tail.load();
+		do {
+			if (t == head.load()) {
+				reading.store(not_reading);
+				return false;
+			}
+			// Announce the element before claiming it, so that the producer does not overwrite it
+			reading.store(t);
+			// The producer may have dropped the element, in that case take the next one
+		} while (!tail.compare_exchange_weak(t, t + 1));
+		ref = std::move(slots[t % slots.size()]);
+		reading.store(not_reading);
+		if (policy == OverflowPolicy::BLOCK) {
+			notify();
+		}
+		return true;
+	}
+
+	void close() {
+		// Wakes up all the waiting threads. The elements already in the buffer can still be taken.
+		std::lock_guard<std::mutex> lg { m };
+		closed.store(true);
+		cv.notify_all();
+	}
+
+	bool is_closed() const {
+		return closed.load();
+	}
+
+	bool wait_pop(T& ref) {
+		// Returns false if the buffer is closed and empty
+		while (!pop(ref)) {
+			if (closed.load() && empty()) {
+				return false;
+			}
+			wait([this] {return !empty() || closed.load();});
+		}
+		return true;
+	}
+
+	template<typename Rep, typename Period>
+	bool wait_pop_for(T& ref, const std::chrono::duration<Rep, Period> &timeout) {
+		// Same as wait_pop, but it also returns false if the timeout expires
+		auto deadline = std::chrono::steady_clock::now() + timeout;
+		while (!pop(ref)) {
+			if (closed.load() && empty()) {
+				return false;
+			}
+			if (!wait_for([this] {return !empty() || closed.load();}, deadline - std::chrono::steady_clock::now())) {
+				return pop(ref);
+			}
+		}
+		return true;
+	}
+
+	template<typename Rep, typename Period>
+	std::vector<T> wait_pop_batch(size_t max_n, const std::chrono::duration<Rep, Period> &timeout) {
+		// Waits until there is at least one element or the timeout expires,
+		// then takes up to max_n elements in one pass.
+		std::vector<T> batch { };
+		if (wait_for([this] {return !empty() || closed.load();}, timeout)) {
+			batch.reserve(std::min(max_n, size()));
+			T ref { };
+			while ((batch.size() < max_n) && pop(ref)) {
+				batch.push_back(std::move(ref));
+			}
+		}
+		return batch;
+	}
+
+	template<typename Container>
+	size_t drain_into(Container &c) {
+		// Moves all the elements currently in the buffer at the end of the container
+		size_t n { 0 };
+		T ref { };
+		while (pop(ref)) {
+			c.push_back(std::move(ref));
+			++n;
+		}
+		return n;
+	}
+
+	void flush() {
+		// Only to be called from the consumer
+		T discard { };
+		while (pop(discard)) {
+		}
+	}
+
+	bool empty() const {
+		return head.load() == tail.load();
+	}
+
+	size_t size() const {
+		size_t t = tail.load();
+		size_t h = head.load();
+		return (h > t) ? h - t : 0;
+	}
+
+	size_t capacity() const {
+		return cap;
+	}
+
+	OverflowPolicy getPolicy() const {
+		return policy;
+	}
+
+	size_t getDropped() const {
+		return dropped.load();
+	}
+};
+
+} /* namespace ScanVan */
+
+#endif /* RINGBUFFER_HPP_ */
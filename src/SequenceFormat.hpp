@@ -0,0 +1,101 @@
+//============================================================================
+// Name        : SequenceFormat.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Layout of the sequence files, the container of the raw
+//				 recordings. A sequence <name> is a set of segment files
+//				 <name>_0000.svs, <name>_0001.svs, ... and the index <name>.svi.
+//
+//				 Segment: one block with SequenceSegmentHeader followed by
+//				 records of a fixed size. A record is one block with
+//				 SequenceRecordHeader followed by the Bayer images of the
+//				 cameras one after the other, padded to a whole number of
+//				 blocks. The segments are preallocated and truncated to the
+//				 written records when they are closed.
+//
+//				 Index: SequenceIndexHeader followed by one SequenceIndexEntry
+//				 per record in the order they were written. It can be rebuilt
+//				 from the headers of the records.
+//============================================================================
+
+#ifndef SEQUENCEFORMAT_HPP_
+#define SEQUENCEFORMAT_HPP_
+
+#include <string>
+#include <cstdio>
+#include <stdint.h>
+
+#include "FrameMetadata.hpp"
+
+namespace ScanVan {
+
+// The headers and the records are aligned on blocks, which suits the pages and O_DIRECT
+constexpr size_t sequenceBlockSize = 4096;
+constexpr uint32_t sequenceVersion = 1;
+constexpr size_t sequenceMaxCam = 2;
+
+struct SequenceSegmentHeader {
+	char magic[8];			// "SVSEQ"
+	uint32_t version;
+	uint32_t segment;		// number of the segment in the sequence
+	uint32_t numCam;
+	uint32_t height;
+	uint32_t width;
+	uint32_t reserved;
+	uint64_t recordSize;	// bytes of a record, multiple of sequenceBlockSize
+	char serial[sequenceMaxCam][64];	// serial numbers of the cameras
+};
+
+struct SequenceRecordHeader {
+	char magic[4];			// "SVRC"
+	uint32_t numCam;
+	int64_t frameNumber;	// image number of the pair
+	uint64_t imageSize;		// bytes of the image of one camera
+	FrameMetadata meta[sequenceMaxCam];
+};
+
+struct SequenceIndexHeader {
+	char magic[8];			// "SVIDX"
+	uint32_t version;
+	uint32_t entrySize;
+};
+
+struct SequenceIndexEntry {
+	int64_t frameNumber;
+	int64_t captureTimeCPU;	// of the camera 0, nanoseconds since the epoch
+	uint32_t segment;
+	uint32_t reserved;
+	uint64_t offset;		// of the record in the segment
+};
+
+static_assert(sizeof(SequenceSegmentHeader) <= sequenceBlockSize, "The segment header must fit in one block");
+static_assert(sizeof(SequenceRecordHeader) <= sequenceBlockSize, "The record header must fit in one block");
+
+constexpr char sequenceSegmentMagic[8] = { 'S', 'V', 'S', 'E', 'Q', '\0', '\0', '\0' };
+constexpr char sequenceRecordMagic[4] = { 'S', 'V', 'R', 'C' };
+constexpr char sequenceIndexMagic[8] = { 'S', 'V', 'I', 'D', 'X', '\0', '\0', '\0' };
+
+inline uint64_t sequenceAlign(uint64_t n) {
+	return (n + sequenceBlockSize - 1) / sequenceBlockSize * sequenceBlockSize;
+}
+
+// Bytes of a record with numCam images of height x width
+inline uint64_t sequenceRecordSize(uint32_t numCam, uint32_t height, uint32_t width) {
+	return sequenceBlockSize + sequenceAlign(static_cast<uint64_t>(numCam) * height * width);
+}
+
+// base is the directory followed by the name of the sequence
+inline std::string sequenceSegmentPath(const std::string &base, uint32_t segment) {
+	char buffer[16];
+	snprintf(buffer, sizeof(buffer), "_%04u.svs", segment);
+	return base + buffer;
+}
+
+inline std::string sequenceIndexPath(const std::string &base) {
+	return base + ".svi";
+}
+
+} /* namespace ScanVan */
+
+#endif /* SEQUENCEFORMAT_HPP_ */
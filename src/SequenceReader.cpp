@@ -0,0 +1,251 @@
+//============================================================================
+// Name        : SequenceReader.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Random access to a sequence written by SequenceWriter.
+//============================================================================
+
+#include "SequenceReader.hpp"
+#include "MappedFrameBuffer.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ScanVan {
+
+SequenceReader::SequenceReader(const std::string &base, size_t readAhead) : base { base }, readAhead { readAhead } {
+	MapSegments();
+	if (!ReadIndex()) {
+		RebuildIndex();
+	}
+	std::cout << "Sequence " << base << ": " << entries.size() << " pairs in " << segments.size() << " segments" << std::endl;
+}
+
+std::vector<std::string> SequenceReader::List(const std::string &dir) {
+// A sequence is recognised by its first segment <name>_0000.svs
+	std::string path { dir };
+	if ((!path.empty()) && (path.back() != '/')) {
+		path += "/";
+	}
+	std::vector<std::string> names { };
+	DIR *d = opendir(path.c_str());
+	if (d == nullptr) {
+		return names;
+	}
+	const std::string suffix { "_0000.svs" };
+	while (struct dirent *entry = readdir(d)) {
+		std::string name { entry->d_name };
+		if ((name.size() > suffix.size()) && (name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)) {
+			names.push_back(path + name.substr(0, name.size() - suffix.size()));
+		}
+	}
+	closedir(d);
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+void SequenceReader::MapSegments() {
+// Maps the segments <base>_0000.svs, <base>_0001.svs, ... until the first one that does not exist
+
+	for (uint32_t n = 0;; ++n) {
+		std::string name = sequenceSegmentPath(base, n);
+		int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			if (n == 0) {
+				throw std::runtime_error("Could not open the sequence " + name);
+			}
+			break;
+		}
+		struct stat st { };
+		if ((fstat(fd, &st) != 0) || (static_cast<uint64_t>(st.st_size) < sequenceBlockSize)) {
+			close(fd);
+			throw std::runtime_error("The segment " + name + " is too short.");
+		}
+		Segment s { };
+		s.size = static_cast<uint64_t>(st.st_size);
+		// Private mapping: an image modified in place gets its own copy of the pages, the file is never written
+		void *p = mmap(nullptr, s.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (p == MAP_FAILED) {
+			throw std::runtime_error("Could not map the segment " + name + ": " + strerror(errno));
+		}
+		uint64_t size = s.size;
+		s.mapping = std::shared_ptr<void>(p, [size](void *q) { munmap(q, size); });
+		s.data = static_cast<uint8_t *>(p);
+
+		SequenceSegmentHeader h { };
+		std::memcpy(&h, s.data, sizeof(h));
+		if ((std::memcmp(h.magic, sequenceSegmentMagic, sizeof(h.magic)) != 0) || (h.version != sequenceVersion) || (h.segment != n)) {
+			throw std::runtime_error("The file " + name + " is not a segment of the sequence.");
+		}
+		if (n == 0) {
+			header = h;
+			if ((header.numCam < 1) || (header.numCam > sequenceMaxCam)
+					|| (header.recordSize != sequenceRecordSize(header.numCam, header.height, header.width))) {
+				throw std::runtime_error("The segment " + name + " has an invalid layout.");
+			}
+		} else if ((h.numCam != header.numCam) || (h.height != header.height) || (h.width != header.width) || (h.recordSize != header.recordSize)) {
+			throw std::runtime_error("The segment " + name + " does not have the layout of the first segment.");
+		}
+		segments.push_back(std::move(s));
+	}
+}
+
+const SequenceRecordHeader & SequenceReader::Record(size_t pos) const {
+	const SequenceIndexEntry &e = entries[pos];
+	return *reinterpret_cast<const SequenceRecordHeader *>(segments[e.segment].data + e.offset);
+}
+
+bool SequenceReader::ReadIndex() {
+// Reads the index written with the sequence. It is rejected if an entry is outside of the segments, or if the
+// segments hold more records than the index, e.g. after the recording was interrupted before its end.
+
+	std::ifstream myFile(sequenceIndexPath(base), std::ios::in | std::ios::binary);
+	if (!myFile) {
+		return false;
+	}
+	SequenceIndexHeader ih { };
+	if ((!myFile.read(reinterpret_cast<char *>(&ih), sizeof(ih))) || (std::memcmp(ih.magic, sequenceIndexMagic, sizeof(ih.magic)) != 0)
+			|| (ih.version != sequenceVersion) || (ih.entrySize != sizeof(SequenceIndexEntry))) {
+		return false;
+	}
+	SequenceIndexEntry e { };
+	std::vector<uint64_t> count(segments.size(), 0);
+	while (myFile.read(reinterpret_cast<char *>(&e), sizeof(e))) {
+		if ((e.segment >= segments.size()) || (e.offset < sequenceBlockSize) || ((e.offset - sequenceBlockSize) % header.recordSize != 0)
+				|| (e.offset + header.recordSize > segments[e.segment].size)) {
+			entries.clear();
+			return false;
+		}
+		++count[e.segment];
+		entries.push_back(e);
+	}
+
+	for (size_t n = 0; n < segments.size(); ++n) {
+		const Segment &s = segments[n];
+		uint64_t next = sequenceBlockSize + count[n] * header.recordSize;
+		if (next + header.recordSize <= s.size) {
+			// The segment has room for another record, it must not hold one
+			if (std::memcmp(s.data + next, sequenceRecordMagic, sizeof(sequenceRecordMagic)) == 0) {
+				entries.clear();
+				return false;
+			}
+		}
+	}
+	return !entries.empty();
+}
+
+void SequenceReader::RebuildIndex() {
+// Reads the header of every record, the images are not touched. The records of a segment end at the
+// first block without the magic, the rest of a preallocated segment is zero.
+
+	entries.clear();
+	for (size_t n = 0; n < segments.size(); ++n) {
+		const Segment &s = segments[n];
+		for (uint64_t offset = sequenceBlockSize; offset + header.recordSize <= s.size; offset += header.recordSize) {
+			SequenceRecordHeader rh { };
+			std::memcpy(&rh, s.data + offset, sizeof(rh));
+			if (std::memcmp(rh.magic, sequenceRecordMagic, sizeof(rh.magic)) != 0) {
+				break;
+			}
+			SequenceIndexEntry e { };
+			e.frameNumber = rh.frameNumber;
+			e.captureTimeCPU = rh.meta[0].captureTimeCPU;
+			e.segment = static_cast<uint32_t>(n);
+			e.offset = offset;
+			entries.push_back(e);
+		}
+	}
+	std::cout << "Rebuilt the index of the sequence " << base << std::endl;
+
+	// The index is written back for the next time, a failure only costs the rebuild
+	std::string name = sequenceIndexPath(base);
+	std::string tmp = name + ".tmp";
+	std::ofstream myFile(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+	SequenceIndexHeader ih { };
+	std::memcpy(ih.magic, sequenceIndexMagic, sizeof(ih.magic));
+	ih.version = sequenceVersion;
+	ih.entrySize = sizeof(SequenceIndexEntry);
+	myFile.write(reinterpret_cast<const char *>(&ih), sizeof(ih));
+	myFile.write(reinterpret_cast<const char *>(entries.data()), entries.size() * sizeof(SequenceIndexEntry));
+	myFile.close();
+	if ((!myFile) || (rename(tmp.c_str(), name.c_str()) != 0)) {
+		std::cerr << "Could not write the index " << name << std::endl;
+		remove(tmp.c_str());
+	}
+}
+
+std::string SequenceReader::GetSerialNumber(size_t idx) const {
+	if (idx >= header.numCam) {
+		throw std::out_of_range("The sequence has no camera with this index.");
+	}
+	return std::string { header.serial[idx], strnlen(header.serial[idx], sizeof(header.serial[idx])) };
+}
+
+void SequenceReader::Read(size_t pos, ImagesRaw &img0, ImagesRaw &img1) {
+
+	if (pos >= entries.size()) {
+		throw std::out_of_range("The position is after the end of the sequence.");
+	}
+	const SequenceIndexEntry &e = entries[pos];
+	const Segment &s = segments[e.segment];
+	const SequenceRecordHeader &rh = Record(pos);
+	uint8_t *p = s.data + e.offset + sequenceBlockSize;
+	const size_t imageSize = static_cast<size_t>(header.height) * header.width;
+
+	ImagesRaw *imgs[sequenceMaxCam] = { &img0, &img1 };
+	for (size_t i = 0; i < header.numCam; ++i) {
+		ImagesRaw &img = *imgs[i];
+		img.setHeight(header.height);
+		img.setWidth(header.width);
+		img.setBuffer(std::make_shared<MappedFrameBuffer>(s.mapping, p + i * imageSize, imageSize));
+		img.setMetadata(rh.meta[i]);
+		img.setSerialNumber(GetSerialNumber(i));
+	}
+
+	Prefetch(pos + 1, pos + 1 + readAhead);
+}
+
+bool SequenceReader::Find(int64_t frameNumber, size_t &pos) const {
+// The image numbers increase along the recording
+	auto it = std::lower_bound(entries.begin(), entries.end(), frameNumber,
+			[](const SequenceIndexEntry &e, int64_t n) { return e.frameNumber < n; });
+	if ((it == entries.end()) || (it->frameNumber != frameNumber)) {
+		return false;
+	}
+	pos = static_cast<size_t>(it - entries.begin());
+	return true;
+}
+
+void SequenceReader::FindTimeRange(int64_t t0, int64_t t1, size_t &first, size_t &last) const {
+// The capture times increase along the recording
+	auto cmp = [](const SequenceIndexEntry &e, int64_t t) { return e.captureTimeCPU < t; };
+	first = static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(), t0, cmp) - entries.begin());
+	last = static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(), t1, cmp) - entries.begin());
+	last = std::max(first, last);
+}
+
+void SequenceReader::Prefetch(size_t first, size_t last) const {
+	static const uint64_t pageSize = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+	last = std::min(last, entries.size());
+	for (size_t pos = first; pos < last; ++pos) {
+		const SequenceIndexEntry &e = entries[pos];
+		const Segment &s = segments[e.segment];
+		uint64_t start = e.offset / pageSize * pageSize;
+		uint64_t end = std::min(e.offset + header.recordSize, s.size);
+		madvise(s.data + start, end - start, MADV_WILLNEED);
+	}
+}
+
+} /* namespace ScanVan */
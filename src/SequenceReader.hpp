@@ -0,0 +1,80 @@
+//============================================================================
+// Name        : SequenceReader.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Random access to a sequence written by SequenceWriter (see
+//				 SequenceFormat.hpp). The segments are mapped into memory and
+//				 the pairs are returned as images that point into the mapping,
+//				 without copying them. The pairs are found by their position,
+//				 their image number or their capture time through the index,
+//				 which is rebuilt from the records when it is missing or does
+//				 not match the segments, and then written back.
+//============================================================================
+
+#ifndef SEQUENCEREADER_HPP_
+#define SEQUENCEREADER_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "SequenceFormat.hpp"
+#include "ImagesRaw.hpp"
+
+namespace ScanVan {
+
+class SequenceReader {
+private:
+	struct Segment {
+		std::shared_ptr<void> mapping { };	// unmapped when the last image that points into it is destroyed
+		uint8_t *data = nullptr;
+		uint64_t size = 0;
+	};
+
+	std::string base;
+	SequenceSegmentHeader header { };
+	std::vector<Segment> segments { };
+	std::vector<SequenceIndexEntry> entries { };	// in the order of the recording
+	size_t readAhead;
+
+	void MapSegments();
+	bool ReadIndex();
+	void RebuildIndex();
+	const SequenceRecordHeader & Record(size_t pos) const;
+
+public:
+	// base is the directory followed by the name of the sequence, without the suffix, e.g. ./data/seq_20190318-182507-123456.
+	// read advises the kernel to load the readAhead following records in the background.
+	SequenceReader(const std::string &base, size_t readAhead = 4);
+
+	SequenceReader(const SequenceReader &) = delete;
+	SequenceReader & operator=(const SequenceReader &) = delete;
+
+	// Names (base) of the sequences of the directory, in the order of their names
+	static std::vector<std::string> List(const std::string &dir);
+
+	size_t size() const { return entries.size(); }
+	size_t GetNumCam() const { return header.numCam; }
+	size_t GetHeight() const { return header.height; }
+	size_t GetWidth() const { return header.width; }
+	std::string GetSerialNumber(size_t idx) const;
+	const SequenceIndexEntry & GetEntry(size_t pos) const { return entries.at(pos); }
+
+	// Sets img0 and img1 (if there are two cameras) to the pair at the position pos, pointing into the mapping
+	void Read(size_t pos, ImagesRaw &img0, ImagesRaw &img1);
+
+	// Position of the pair with the image number, returns false if it was not recorded
+	bool Find(int64_t frameNumber, size_t &pos) const;
+
+	// Positions [first, last) of the pairs captured in [t0, t1), nanoseconds since the epoch
+	void FindTimeRange(int64_t t0, int64_t t1, size_t &first, size_t &last) const;
+
+	// Advises the kernel to load the records [first, last) in the background
+	void Prefetch(size_t first, size_t last) const;
+};
+
+} /* namespace ScanVan */
+
+#endif /* SEQUENCEREADER_HPP_ */
@@ -0,0 +1,200 @@
+//============================================================================
+// Name        : SequenceWriter.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Appends the raw pairs to a sequence.
+//============================================================================
+
+#include "SequenceWriter.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+namespace ScanVan {
+
+static void writeAll(int fd, struct iovec *iov, int n, uint64_t offset, const std::string &name) {
+// Writes all the buffers at the offset, resuming after a partial write at the advanced offset.
+// The position of the file is not used, so a failed write is overwritten by the next one at the same offset.
+	while (n > 0) {
+		ssize_t w = pwritev(fd, iov, n, static_cast<off_t>(offset));
+		if (w < 0) {
+			if (errno == EINTR) continue;
+			throw std::runtime_error("Error writing the file " + name + ": " + strerror(errno));
+		}
+		size_t done = static_cast<size_t>(w);
+		offset += done;
+		while ((n > 0) && (done >= iov->iov_len)) {
+			done -= iov->iov_len;
+			++iov;
+			--n;
+		}
+		if (n > 0) {
+			iov->iov_base = static_cast<char *>(iov->iov_base) + done;
+			iov->iov_len -= done;
+		}
+	}
+}
+
+SequenceWriter::SequenceWriter(const std::string &path, uint64_t segmentBytes) : path { path }, segmentBytes { segmentBytes } {
+	if ((!this->path.empty()) && (this->path.back() != '/')) {
+		this->path += "/";
+	}
+}
+
+void SequenceWriter::Start(const ImagesRaw &img0, const ImagesRaw &img1) {
+// Fixes the layout of the records from the first pair and creates the index
+
+	if (img0.getImgBufferSize() == 0) {
+		throw std::runtime_error("The first image of a pair stored in a sequence must have pixels.");
+	}
+	if ((mkdir(path.c_str(), 0755) != 0) && (errno != EEXIST)) {
+		throw std::runtime_error("Could not create the directory " + path);
+	}
+	base = path + "seq_" + formatHostTimeFileName(img0.getCaptureCPUTime());
+	records = 0;
+
+	header = SequenceSegmentHeader { };
+	std::memcpy(header.magic, sequenceSegmentMagic, sizeof(header.magic));
+	header.version = sequenceVersion;
+	header.numCam = (img1.getImgBufferSize() != 0) ? 2 : 1;
+	header.height = static_cast<uint32_t>(img0.getHeight());
+	header.width = static_cast<uint32_t>(img0.getWidth());
+	header.recordSize = sequenceRecordSize(header.numCam, header.height, header.width);
+	strncpy(header.serial[0], img0.getSerialNumber().c_str(), sizeof(header.serial[0]) - 1);
+	if (header.numCam == 2) {
+		strncpy(header.serial[1], img1.getSerialNumber().c_str(), sizeof(header.serial[1]) - 1);
+	}
+
+	segmentBytes = std::max(segmentBytes, sequenceBlockSize + header.recordSize);
+	segmentBytes = sequenceBlockSize + (segmentBytes - sequenceBlockSize) / header.recordSize * header.recordSize;
+
+	block.assign(sequenceBlockSize, 0);
+	padding.assign(header.recordSize - sequenceBlockSize - static_cast<uint64_t>(header.numCam) * header.height * header.width, 0);
+
+	std::string name = sequenceIndexPath(base);
+	indexFd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (indexFd < 0) {
+		throw std::runtime_error("Could not open the file " + name + " for writing");
+	}
+	SequenceIndexHeader ih { };
+	std::memcpy(ih.magic, sequenceIndexMagic, sizeof(ih.magic));
+	ih.version = sequenceVersion;
+	ih.entrySize = sizeof(SequenceIndexEntry);
+	struct iovec iov { &ih, sizeof(ih) };
+	writeAll(indexFd, &iov, 1, 0, name);
+
+	segment = 0;
+	OpenSegment();
+	started = true;
+	std::cout << "Recording the sequence " << base << std::endl;
+}
+
+void SequenceWriter::OpenSegment() {
+// Creates the segment with its full size reserved, so the file system allocates it in large extents
+
+	std::string name = sequenceSegmentPath(base, segment);
+	segmentFd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (segmentFd < 0) {
+		throw std::runtime_error("Could not open the file " + name + " for writing");
+	}
+	int err = posix_fallocate(segmentFd, 0, static_cast<off_t>(segmentBytes));
+	if (err != 0) {
+		std::cerr << "Could not preallocate " << name << ": " << strerror(err) << std::endl;
+	}
+
+	header.segment = segment;
+	std::fill(block.begin(), block.end(), 0);
+	std::memcpy(block.data(), &header, sizeof(header));
+	struct iovec iov { block.data(), block.size() };
+	writeAll(segmentFd, &iov, 1, 0, name);
+	offset = sequenceBlockSize;
+}
+
+void SequenceWriter::CloseSegment() {
+// The preallocated space after the last record is given back
+	if (segmentFd < 0) return;
+	if (ftruncate(segmentFd, static_cast<off_t>(offset)) != 0) {
+		std::cerr << "Could not truncate " << sequenceSegmentPath(base, segment) << ": " << strerror(errno) << std::endl;
+	}
+	::close(segmentFd);
+	segmentFd = -1;
+}
+
+void SequenceWriter::append(const ImagesRaw &img0, const ImagesRaw &img1) {
+
+	if (!started) {
+		Start(img0, img1);
+	}
+	const uint64_t imageSize = static_cast<uint64_t>(header.height) * header.width;
+	if ((img0.getImgBufferSize() != imageSize) || ((header.numCam == 2) && (img1.getImgBufferSize() != imageSize))) {
+		throw std::runtime_error("The images of a sequence must all have the size of the first pair.");
+	}
+
+	if (offset + header.recordSize > segmentBytes) {
+		CloseSegment();
+		++segment;
+		OpenSegment();
+	}
+
+	SequenceRecordHeader rh { };
+	std::memcpy(rh.magic, sequenceRecordMagic, sizeof(rh.magic));
+	rh.numCam = header.numCam;
+	rh.frameNumber = img0.getImgNumber();
+	rh.imageSize = imageSize;
+	rh.meta[0] = img0.getMetadata();
+	if (header.numCam == 2) {
+		rh.meta[1] = img1.getMetadata();
+	}
+	std::fill(block.begin(), block.end(), 0);
+	std::memcpy(block.data(), &rh, sizeof(rh));
+
+	// Header, images and padding in one call
+	struct iovec iov[4] { };
+	int n = 0;
+	iov[n++] = { block.data(), block.size() };
+	iov[n++] = { const_cast<uint8_t *>(img0.getData()), imageSize };
+	if (header.numCam == 2) {
+		iov[n++] = { const_cast<uint8_t *>(img1.getData()), imageSize };
+	}
+	if (!padding.empty()) {
+		iov[n++] = { padding.data(), padding.size() };
+	}
+	writeAll(segmentFd, iov, n, offset, sequenceSegmentPath(base, segment));
+
+	SequenceIndexEntry entry { };
+	entry.frameNumber = rh.frameNumber;
+	entry.captureTimeCPU = rh.meta[0].captureTimeCPU;
+	entry.segment = segment;
+	entry.offset = offset;
+	struct iovec ie { &entry, sizeof(entry) };
+	writeAll(indexFd, &ie, 1, sizeof(SequenceIndexHeader) + records * sizeof(SequenceIndexEntry), sequenceIndexPath(base));
+
+	offset += header.recordSize;
+	++records;
+}
+
+void SequenceWriter::close() {
+	CloseSegment();
+	if (indexFd >= 0) {
+		::close(indexFd);
+		indexFd = -1;
+	}
+	if (started) {
+		std::cout << "Sequence " << base << ": " << records << " pairs in " << segment + 1 << " segments" << std::endl;
+		started = false;
+	}
+}
+
+SequenceWriter::~SequenceWriter() {
+	close();
+}
+
+} /* namespace ScanVan */
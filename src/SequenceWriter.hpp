@@ -0,0 +1,68 @@
+//============================================================================
+// Name        : SequenceWriter.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Appends the raw pairs to a sequence (see SequenceFormat.hpp).
+//				 Each pair is written with a single system call at the end of
+//				 a preallocated segment, so the recording is sequential I/O
+//				 into a few large files instead of two files per image.
+//============================================================================
+
+#ifndef SEQUENCEWRITER_HPP_
+#define SEQUENCEWRITER_HPP_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "SequenceFormat.hpp"
+#include "ImagesRaw.hpp"
+
+namespace ScanVan {
+
+class SequenceWriter {
+private:
+	std::string path;					// directory of the sequences
+	std::string base;					// directory and name of the sequence, set by the first pair
+	uint64_t segmentBytes;				// size of the preallocated segments
+	SequenceSegmentHeader header { };	// set by the first pair
+	bool started { false };
+
+	int segmentFd { -1 };
+	uint32_t segment { 0 };
+	uint64_t offset { 0 };				// end of the written records in the segment
+	int indexFd { -1 };
+	uint64_t records { 0 };
+
+	std::vector<char> block { };		// header of the record
+	std::vector<char> padding { };		// zeros to complete the last block of a record
+
+	void Start(const ImagesRaw &img0, const ImagesRaw &img1);
+	void OpenSegment();
+	void CloseSegment();
+
+public:
+	// The files are created in path, the name of the sequence is given by the time of the first pair.
+	// segmentBytes is rounded up to hold at least one record.
+	SequenceWriter(const std::string &path, uint64_t segmentBytes);
+
+	SequenceWriter(const SequenceWriter &) = delete;
+	SequenceWriter & operator=(const SequenceWriter &) = delete;
+
+	// Appends the pair, img1 has no pixels when there is one camera.
+	// All the pairs of a sequence have the number of cameras and the size of the first one.
+	void append(const ImagesRaw &img0, const ImagesRaw &img1);
+
+	// Truncates the last segment to the written records and closes the files
+	void close();
+
+	uint64_t getRecords() const { return records; }
+	std::string getBase() const { return base; }
+
+	virtual ~SequenceWriter();
+};
+
+} /* namespace ScanVan */
+
+#endif /* SEQUENCEWRITER_HPP_ */
@@ -0,0 +1,76 @@
+//============================================================================
+// Name        : SimulatedCameraSource.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source that generates BayerRG8 images.
+//============================================================================
+
+#include "SimulatedCameraSource.hpp"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace ScanVan {
+
+SimulatedCameraSource::SimulatedCameraSource(const CameraSettings &s) : settings { s } {
+}
+
+void SimulatedCameraSource::Open() {
+	if ((settings.numCameras < 1) || (settings.numCameras > 2)) {
+		throw std::runtime_error("The simulated source supports one or two cameras.");
+	}
+	for (size_t i = 0; i < settings.numCameras; ++i) {
+		std::stringstream ss { };
+		ss << "SIM" << i;
+		serialNumbers.push_back(ss.str());
+		std::cout << "Using simulated camera " << i << " (SN:" << serialNumbers.back() << ")" << std::endl;
+	}
+	startTime = hostTimeNow();
+}
+
+void SimulatedCameraSource::Trigger() {
+	// Nothing to do, the images are generated at the retrieval. The time of the trigger comes with the
+	// images (capture time of the CPU), so it belongs to the trigger of the pair even if others follow.
+}
+
+void SimulatedCameraSource::Generate(ImagesRaw &img, size_t idx) {
+// Writes a diagonal gradient in the RGGB mosaic, shifted with the image number and the camera index
+
+	size_t h = img.getHeight();
+	size_t w = img.getWidth();
+	if (img.getImgBufferSize() == 0) {
+		img.setBuffer(std::make_shared<HeapFrameBuffer>(h * w));
+	}
+	uint8_t *p = img.getBufferP();
+
+	const unsigned shift = static_cast<unsigned>(frameCounter * 8 + idx * 64);
+	for (size_t r = 0; r < h; ++r) {
+		uint8_t *row = p + r * w;
+		for (size_t c = 0; c < w; ++c) {
+			// 0 for R, 1 for G and 2 for B
+			unsigned channel = static_cast<unsigned>((r & 1) + (c & 1));
+			row[c] = static_cast<uint8_t>(((r + c) / 8 + shift + channel * 85) & 0xFF);
+		}
+	}
+
+	// The time stamp of the camera is the time of the trigger, counted from the opening of the source
+	const int64_t trigger = (img.getCaptureCPUTime() != 0) ? img.getCaptureCPUTime() : hostTimeNow();
+	img.setCaptureCamTime(trigger - startTime);
+	img.setExposureTime(settings.exposureTime);
+	img.setGain(settings.gain);
+	img.setBalanceR(1.0);
+	img.setBalanceG(1.0);
+	img.setBalanceB(1.0);
+}
+
+bool SimulatedCameraSource::Retrieve(ImagesRaw &img0, ImagesRaw &img1) {
+	Generate(img0, 0);
+	if (serialNumbers.size() == 2) {
+		Generate(img1, 1);
+	}
+	++frameCounter;
+	return true;
+}
+
+} /* namespace ScanVan */
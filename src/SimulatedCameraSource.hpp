@@ -0,0 +1,45 @@
+//============================================================================
+// Name        : SimulatedCameraSource.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Source that generates BayerRG8 images, so the pipeline can be
+//				 run and measured on a computer without cameras. The pattern
+//				 moves with every image and is different for each camera.
+//============================================================================
+
+#ifndef SIMULATEDCAMERASOURCE_HPP_
+#define SIMULATEDCAMERASOURCE_HPP_
+
+#include <vector>
+#include <stdint.h>
+
+#include "CameraSource.hpp"
+
+namespace ScanVan {
+
+class SimulatedCameraSource: public ICameraSource {
+private:
+	CameraSettings settings;
+	std::vector<std::string> serialNumbers {};
+
+	long int frameCounter { 0 };
+	int64_t startTime { 0 };	// host time of Open, origin of the clock of the simulated cameras
+
+	void Generate(ImagesRaw &img, size_t idx);
+
+public:
+	SimulatedCameraSource(const CameraSettings &s);
+
+	void Open();
+	size_t GetNumCam() const { return serialNumbers.size(); };
+	std::string GetSerialNumber(size_t idx) const { return serialNumbers.at(idx); };
+	void Trigger();
+	bool Retrieve(ImagesRaw &img0, ImagesRaw &img1);
+
+	virtual ~SimulatedCameraSource() {};
+};
+
+} /* namespace ScanVan */
+
+#endif /* SIMULATEDCAMERASOURCE_HPP_ */
@@ -0,0 +1,53 @@
+//============================================================================
+// Name        : StorageFile.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : A file prepared by the storage.
+//============================================================================
+
+#include "StorageFile.hpp"
+
+#include <stdexcept>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace ScanVan {
+
+void StorageFile::writeAt(int dirfd) const {
+	int fd = openat(dirfd, name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		throw std::runtime_error("Could not open the file " + name + " for writing");
+	}
+	const uint8_t *p = data();
+	size_t n = size();
+	while (n > 0) {
+		ssize_t w = write(fd, p, n);
+		if (w < 0) {
+			if (errno == EINTR) continue;
+			close(fd);
+			throw std::runtime_error("Error writing the file " + name);
+		}
+		p += w;
+		n -= static_cast<size_t>(w);
+	}
+	close(fd);
+}
+
+int openStorageDirectory(const std::string &path) {
+	int dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0) {
+		if ((mkdir(path.c_str(), 0755) != 0) && (errno != EEXIST)) {
+			throw std::runtime_error("Could not create the directory " + path);
+		}
+		dirfd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		if (dirfd < 0) {
+			throw std::runtime_error("Could not open the directory " + path);
+		}
+	}
+	return dirfd;
+}
+
+} /* namespace ScanVan */
@@ -0,0 +1,45 @@
+//============================================================================
+// Name        : StorageFile.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : A file prepared by the storage: its name in the data
+//				 directory and its content, encoded but not yet written. The
+//				 storage threads prepare and write the files of the pairs
+//				 concurrently, the files marked commit (the camera data that
+//				 refers to the image) are then written in the order of the
+//				 pairs, once the images they refer to are complete.
+//============================================================================
+
+#ifndef STORAGEFILE_HPP_
+#define STORAGEFILE_HPP_
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "FrameBuffer.hpp"
+
+namespace ScanVan {
+
+struct StorageFile {
+	std::string name { };						// relative to the data directory
+	std::vector<uint8_t> bytes { };				// content, unless image is set
+	std::shared_ptr<const FrameBuffer> image { };	// raw image written as it is, without copying it
+	size_t imageSize { 0 };						// bytes of image to write
+	bool commit { false };						// written by the commit, after the other files of the pair
+
+	const uint8_t * data() const { return (image) ? image->data() : bytes.data(); }
+	size_t size() const { return (image) ? imageSize : bytes.size(); }
+
+	// Writes the file relative to the directory dirfd with a single system call
+	void writeAt(int dirfd) const;
+};
+
+// Opens the data directory for writeAt, it is created if it does not exist
+int openStorageDirectory(const std::string &path);
+
+} /* namespace ScanVan */
+
+#endif /* STORAGEFILE_HPP_ */
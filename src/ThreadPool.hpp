@@ -0,0 +1,128 @@
+//============================================================================
+// Name        : ThreadPool.hpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : Fixed pool of worker threads. parallel_for spreads the
+//				 indices of a loop over the workers and the calling thread;
+//				 the indices are taken one by one from a shared counter, so a
+//				 slow index does not hold back the others.
+//============================================================================
+
+#ifndef THREADPOOL_HPP_
+#define THREADPOOL_HPP_
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+
+namespace ScanVan {
+
+class ThreadPool {
+private:
+	std::vector<std::thread> workers { };
+	std::deque<std::function<void()>> tasks { };
+	std::mutex m { };
+	std::condition_variable cv { };
+	bool stopping { false };
+
+	void Run() {
+		while (true) {
+			std::function<void()> task { };
+			{
+				std::unique_lock<std::mutex> lg { m };
+				cv.wait(lg, [this] { return stopping || !tasks.empty(); });
+				if (tasks.empty()) {
+					// Stopping and nothing left to do
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			task();
+		}
+	}
+
+public:
+	explicit ThreadPool(size_t numThreads) {
+		// With 0 or 1 thread the work is done by the calling thread only
+		for (size_t i = 1; i < numThreads; ++i) {
+			workers.emplace_back(&ThreadPool::Run, this);
+		}
+	}
+
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool & operator=(const ThreadPool &) = delete;
+
+	// Number of threads that take part in parallel_for, the calling thread included
+	size_t size() const { return workers.size() + 1; }
+
+	void submit(std::function<void()> task) {
+		std::lock_guard<std::mutex> lg { m };
+		tasks.push_back(std::move(task));
+		cv.notify_one();
+	}
+
+	void parallel_for(size_t count, const std::function<void(size_t)> &body) {
+		// Calls body(i) for i in [0, count) and returns when all the calls are done.
+		// The first exception thrown by body is rethrown here.
+		if (count == 0) return;
+
+		struct Loop {
+			std::atomic<size_t> next { 0 };
+			std::mutex m { };
+			std::condition_variable cv { };
+			size_t running { 0 };
+			std::exception_ptr error { };
+		};
+		auto loop = std::make_shared<Loop>();
+
+		auto work = [loop, count, &body]() {
+			try {
+				for (size_t i = loop->next++; i < count; i = loop->next++) {
+					body(i);
+				}
+			} catch (...) {
+				std::lock_guard<std::mutex> lg { loop->m };
+				if (!loop->error) loop->error = std::current_exception();
+				// The other threads stop at their next index
+				loop->next = count;
+			}
+			std::lock_guard<std::mutex> lg { loop->m };
+			if (--loop->running == 0) loop->cv.notify_all();
+		};
+
+		size_t helpers = std::min(workers.size(), count - 1);
+		loop->running = helpers + 1;
+		for (size_t i = 0; i < helpers; ++i) {
+			submit(work);
+		}
+		work();
+
+		std::unique_lock<std::mutex> lg { loop->m };
+		loop->cv.wait(lg, [&loop] { return loop->running == 0; });
+		if (loop->error) std::rethrow_exception(loop->error);
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lg { m };
+			stopping = true;
+			cv.notify_all();
+		}
+		for (auto &t : workers) {
+			t.join();
+		}
+	}
+};
+
+} /* namespace ScanVan */
+
+#endif /* THREADPOOL_HPP_ */
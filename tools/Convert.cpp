@@ -0,0 +1,261 @@
+//============================================================================
+// Name        : Convert.cpp
+// Author      : Marcelo Kaihara
+// Version     : 1.0
+// Copyright   :
+// Description : scanvanConvert, converts a recorded session of raw pairs
+//				 (files or sequences) into equirectangular images offline,
+//				 with all the cores of the machine. The pairs are spread over
+//				 the threads one by one, a thread that finishes takes the
+//				 next pair not yet taken. An image is written under a
+//				 temporary name and renamed once complete, so an interrupted
+//				 run is resumed by running it again: the pairs whose image
+//				 exists are skipped.
+//
+//				 scanvanConvert <session directory> <calibration directory> [options]
+//============================================================================
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "ReplayCameraSource.hpp"
+#include "PairImages.hpp"
+#include "RemapEngine.hpp"
+#include "MapCache.hpp"
+#include "ImageEncoding.hpp"
+#include "StorageFile.hpp"
+#include "ThreadPool.hpp"
+
+using namespace ScanVan;
+
+namespace {
+
+struct Options {
+	std::string session { };
+	std::string calibration { };
+	std::string output { };				// default: <session>/equirect/
+	ImageEncoding encoding { };
+	Interpolation interp { Interpolation::CUBIC };	// bicubic on the demosaiced images (see RemapEngine::run)
+	size_t threads { 0 };				// 0 for one per core
+	size_t height { CameraSettings { }.height };	// size of the images of the sessions of files
+	size_t width { CameraSettings { }.width };
+	bool overwrite { false };
+};
+
+void Usage(const char *name) {
+	std::cerr << "Usage: " << name << " <session directory> <calibration directory> [options]" << std::endl
+			<< "  The calibration directory holds calibration_<serial number>/ of each camera." << std::endl
+			<< "  -o, --output <dir>          output directory, default <session>/equirect/" << std::endl
+			<< "  -f, --format <format>       bmp, jpg, png or webp, default jpg" << std::endl
+			<< "  --jpeg-quality <0-100>      default 95" << std::endl
+			<< "  --png-compression <0-9>     default 3" << std::endl
+			<< "  --webp-quality <1-101>      default 90, 101 is lossless" << std::endl
+			<< "  --chroma <444|422|420>      JPEG chroma subsampling, default 420" << std::endl
+			<< "  --interp <interpolation>    nearest, linear or cubic, default cubic" << std::endl
+			<< "                              cubic demosaics the images in full first, linear is a single faster pass" << std::endl
+			<< "  -j, --threads <n>           default 0, one per core" << std::endl
+			<< "  --height <pixels>           size of the raw files, default 3008" << std::endl
+			<< "  --width <pixels>            the sequences give their own size" << std::endl
+			<< "  --overwrite                 converts again the pairs already converted" << std::endl;
+}
+
+bool ParseOptions(int argc, char *argv[], Options &opt) {
+	opt.encoding.format = "jpg";
+	std::vector<std::string> positional { };
+	for (int i = 1; i < argc; ++i) {
+		std::string arg { argv[i] };
+		auto value = [&]() -> std::string {
+			if (i + 1 >= argc) {
+				throw std::runtime_error("Missing value of the option " + arg);
+			}
+			return argv[++i];
+		};
+		if ((arg == "-o") || (arg == "--output")) {
+			opt.output = value();
+		} else if ((arg == "-f") || (arg == "--format")) {
+			opt.encoding.format = value();
+		} else if (arg == "--jpeg-quality") {
+			opt.encoding.jpegQuality = std::stoi(value());
+		} else if (arg == "--png-compression") {
+			opt.encoding.pngCompression = std::stoi(value());
+		} else if (arg == "--webp-quality") {
+			opt.encoding.webpQuality = std::stoi(value());
+		} else if (arg == "--chroma") {
+			opt.encoding.chromaSubsampling = value();
+		} else if (arg == "--interp") {
+			opt.interp = interpolationFromString(value());
+		} else if ((arg == "-j") || (arg == "--threads")) {
+			opt.threads = std::stoul(value());
+		} else if (arg == "--height") {
+			opt.height = std::stoul(value());
+		} else if (arg == "--width") {
+			opt.width = std::stoul(value());
+		} else if (arg == "--overwrite") {
+			opt.overwrite = true;
+		} else if ((arg == "-h") || (arg == "--help")) {
+			return false;
+		} else if ((!arg.empty()) && (arg[0] == '-')) {
+			throw std::runtime_error("Unknown option " + arg);
+		} else {
+			positional.push_back(arg);
+		}
+	}
+	if (positional.size() != 2) {
+		return false;
+	}
+	opt.session = positional[0];
+	opt.calibration = positional[1];
+	for (std::string *dir : { &opt.session, &opt.calibration, &opt.output }) {
+		if ((!dir->empty()) && (dir->back() != '/')) {
+			*dir += "/";
+		}
+	}
+	if (opt.output.empty()) {
+		opt.output = opt.session + "equirect/";
+	}
+	opt.encoding.validate();
+	return true;
+}
+
+bool FileExists(int dirfd, const std::string &name) {
+	struct stat st { };
+	return fstatat(dirfd, name.c_str(), &st, 0) == 0;
+}
+
+void WriteComplete(int dirfd, StorageFile &f) {
+// The file gets its name once complete, an interrupted run leaves only a .part file behind
+	const std::string name = f.name;
+	f.name = name + ".part";
+	f.writeAt(dirfd);
+	if (renameat(dirfd, f.name.c_str(), dirfd, name.c_str()) != 0) {
+		throw std::runtime_error("Could not rename the file " + f.name);
+	}
+}
+
+} /* namespace */
+
+int main(int argc, char* argv[])
+{
+	Options opt { };
+	try {
+		if (!ParseOptions(argc, argv, opt)) {
+			Usage(argv[0]);
+			return 1;
+		}
+	} catch (const std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		Usage(argv[0]);
+		return 1;
+	}
+
+	int exitCode { 0 };
+
+	try {
+		CameraSettings settings { };
+		settings.replay_path = opt.session;
+		settings.height = opt.height;
+		settings.width = opt.width;
+		// The size of the sequences is the recorded one
+		std::vector<std::string> sequences = SequenceReader::List(opt.session);
+		if (!sequences.empty()) {
+			SequenceReader first { sequences.front() };
+			settings.height = first.GetHeight();
+			settings.width = first.GetWidth();
+		}
+		ReplayCameraSource source { settings };
+		source.Open();
+		const size_t numPairs = source.GetNumPairs();
+
+		// Each pair is converted by one thread, the engine only holds the tiles of the maps
+		RemapEngine engine { 1 };
+		std::vector<CalibrationMaps> maps { };
+		for (size_t i = 0; i < source.GetNumCam(); ++i) {
+			std::string sn = source.GetSerialNumber(i);
+			MapCache cache { opt.calibration + "calibration_" + sn + "/", sn };
+			maps.push_back(cache.Load());
+			engine.setMaps(i, maps.back().map1s, maps.back().map2s);
+		}
+
+		int dirfd = openStorageDirectory(opt.output);
+
+		StorageOptions storage { };
+		storage.encoding = opt.encoding;
+		storage.equirect = &engine;
+		storage.interp = opt.interp;
+
+		ThreadPool pool { (opt.threads == 0) ? std::max<size_t>(1, std::thread::hardware_concurrency()) : opt.threads };
+		std::cout << "Converting " << numPairs << " pairs to " << opt.output << " (" << opt.encoding.format << ", "
+				<< interpolationToString(opt.interp) << ") on " << pool.size() << " threads" << std::endl;
+
+		std::atomic<size_t> converted { 0 };
+		std::atomic<size_t> skipped { 0 };
+		std::atomic<size_t> failed { 0 };
+		std::atomic<size_t> done { 0 };
+		std::mutex printMutex { };
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+		pool.parallel_for(numPairs, [&](size_t pos) {
+			try {
+				// The name is the one given by saveDataConcat, the capture time of the camera 0
+				int64_t t = source.GetCaptureTime(pos);
+				if (t == 0) {
+					throw std::runtime_error("the pair has no capture time to name its image");
+				}
+				std::string name = formatHostTimeFileName(t) + opt.encoding.extension();
+				if ((!opt.overwrite) && FileExists(dirfd, name)) {
+					++skipped;
+				} else {
+					ImagesRaw img0 { };
+					ImagesRaw img1 { };
+					source.Read(pos, img0, img1);
+					PairImages imgs = (img1.getImgBufferSize() != 0) ? PairImages { std::move(img0), std::move(img1) } : PairImages { std::move(img0) };
+					std::vector<StorageFile> files { };
+					imgs.encodePair(opt.output, storage, files);
+					for (auto &f : files) {
+						WriteComplete(dirfd, f);
+					}
+					++converted;
+				}
+			} catch (const std::exception &e) {
+				++failed;
+				std::lock_guard<std::mutex> lg { printMutex };
+				std::cerr << "Pair " << pos << ": " << e.what() << std::endl;
+			}
+
+			size_t n = ++done;
+			if ((n % 100 == 0) || (n == numPairs)) {
+				std::chrono::duration<double> d = std::chrono::steady_clock::now() - t1;
+				std::lock_guard<std::mutex> lg { printMutex };
+				std::cout << n << " / " << numPairs << " pairs, " << converted / d.count() << " pairs/s" << std::endl;
+			}
+		});
+
+		close(dirfd);
+
+		std::chrono::duration<double> d = std::chrono::steady_clock::now() - t1;
+		std::cout << "Converted: " << converted << ", already done: " << skipped << ", failed: " << failed
+				<< ", in " << d.count() << " s" << std::endl;
+		if (failed > 0) {
+			std::cerr << "Run the conversion again to retry the pairs that failed." << std::endl;
+			exitCode = 1;
+		}
+
+	} catch (const std::exception &e) {
+		std::cerr << "An exception occurred." << std::endl << e.what() << std::endl;
+		exitCode = 1;
+	}
+
+	return exitCode;
+}